@@ -180,6 +180,7 @@ cython(
     define_macros=macros)
 
 # renpy
+cython("renpy.atlsupport")
 cython("renpy.parsersupport")
 cython("renpy.pydict")
 cython("renpy.style")
@@ -405,6 +405,7 @@ def import_all():
 
     import renpy.ast
     import renpy.atl
+    import renpy.atlsupport
     import renpy.curry
     import renpy.color
     import renpy.easy
@@ -710,6 +711,7 @@ if False:
 
     import renpy.ast
     import renpy.atl
+    import renpy.atlsupport
     import renpy.curry
     import renpy.color
     import renpy.easy
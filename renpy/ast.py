@@ -809,6 +809,31 @@ class Init(Node):
         callback(self.block)
 
 
+class LazyBlock(list):
+    """
+    An empty list that stands in for the block of a label that hasn't been
+    loaded yet. The block is stored on its own in slot 4 of the .rpyc file,
+    and is loaded by Script.materialize when the label is first used.
+    """
+
+    def __init__(self, offset, length, names, translates):
+        list.__init__(self)
+
+        # The offset and length of the compressed block in slot 4.
+        self.offset = offset
+        self.length = length
+
+        # The names of the nodes in the block.
+        self.names = names
+
+        # The identifiers of the translate statements in the block.
+        self.translates = translates
+
+        # The name of the .rpyc file the block is loaded from. This is set
+        # when the file is loaded.
+        self.filename = None
+
+
 class Label(Node):
 
     rollback = "force"
@@ -860,7 +885,17 @@ class Label(Node):
         else:
             self.next = next
 
+    def materialize(self):
+        """
+        Loads the block of this label, if it hasn't been loaded yet.
+        """
+
+        if self.block.__class__ is LazyBlock:
+            renpy.game.script.materialize(self)
+
     def execute(self):
+        self.materialize()
+
         next_node(self.next)
         statement_name("label")
 
@@ -878,6 +913,14 @@ class Label(Node):
         if renpy.config.label_callback:
             renpy.config.label_callback(self.name, renpy.game.context().last_abnormal)
 
+    def predict(self):
+        self.materialize()
+        return Node.predict(self)
+
+    def scry(self):
+        self.materialize()
+        return Node.scry(self)
+
     def restructure(self, callback):
         callback(self.block)
 
@@ -25,6 +25,8 @@ from renpy.compat import *
 import renpy.display
 import renpy.pyanalysis
 
+from renpy.atlsupport import Interpolator
+
 import random
 
 
@@ -34,10 +36,20 @@ def compiling(loc):
     renpy.game.exception_info = "Compiling ATL code at %s:%d" % (file, number)
 
 
+# A map from a location to the exception info used when executing the ATL
+# at that location. This is set for each statement on every frame, so it's
+# worth not formatting it each time.
+executing_info = { }
+
+
 def executing(loc):
-    file, number = loc # @ReservedAssignment
+    info = executing_info.get(loc, None)
+
+    if info is None:
+        file, number = loc # @ReservedAssignment
+        info = executing_info[loc] = "Executing ATL code at %s:%d" % (file, number)
 
-    renpy.game.exception_info = "Executing ATL code at %s:%d" % (file, number)
+    renpy.game.exception_info = info
 
 
 # A map from the name of a time warp function to the function itself.
@@ -1117,6 +1129,13 @@ class Child(Statement):
 # This causes interpolation to occur.
 class Interpolation(Statement):
 
+    # A (linear, Interpolator) tuple, caching the Interpolator compiled
+    # from the linear dictionary in the state. It isn't saved, so saves
+    # contain only the dictionary.
+    interpolator = None
+
+    nosave = [ 'interpolator' ]
+
     def __init__(self, loc, warper, duration, properties, revolution, circles, splines):
 
         super(Interpolation, self).__init__(loc)
@@ -1240,22 +1259,23 @@ class Interpolation(Statement):
             for name, values in self.splines:
                 splines.append((name, [ getattr(trans.state, name) ] + values))
 
-            state = (linear, revolution, splines)
-
             # Ensure that we set things, even if they don't actually
             # change from the old state.
             for k, v in self.properties:
                 if k not in linear:
                     setattr(trans.state, k, v)
 
+            state = (linear, revolution, splines)
+
         else:
             linear, revolution, splines = state
 
-        # Linearly interpolate between the things in linear.
-        for k, (old, new) in linear.items():
-            value = interpolate(complete, old, new, PROPERTIES[k])
+        # Linearly interpolate between the things in linear, with the
+        # Interpolator compiled from it the first time it's needed.
+        if (self.interpolator is None) or (self.interpolator[0] is not linear):
+            self.interpolator = (linear, Interpolator(linear))
 
-            setattr(trans.state, k, value)
+        self.interpolator[1].apply(trans.state, complete)
 
         # Handle the revolution.
         if revolution is not None:
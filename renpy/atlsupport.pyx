@@ -0,0 +1,175 @@
+# Copyright 2004-2021 Tom Rothamel <pytom@bishoujo.us>
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation files
+# (the "Software"), to deal in the Software without restriction,
+# including without limitation the rights to use, copy, modify, merge,
+# publish, distribute, sublicense, and/or sell copies of the Software,
+# and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+# OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+# WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+# This file contains the parts of ATL that are run for every interpolating
+# statement, on every frame, and so benefit from being compiled.
+
+from __future__ import print_function
+
+from libc.stdlib cimport malloc, free
+
+import renpy
+
+# The kinds of value an Interpolator can produce.
+DEF FLOAT = 0
+DEF INT = 1
+DEF ABSOLUTE = 2
+DEF OBJECT = 3
+
+
+cdef int value_kind(old, new, ty):
+    """
+    Returns the kind of value that interpolating from `old` to `new` with
+    the property type `ty` produces, or OBJECT if it can't be done with
+    C doubles.
+    """
+
+    if (old is not None) and not isinstance(old, (int, float)):
+        return OBJECT
+
+    if ty is renpy.atl.position:
+
+        if type(new) is float:
+            return FLOAT
+        elif type(new) is int:
+            return INT
+        elif type(new) is renpy.display.core.absolute:
+            return ABSOLUTE
+
+        return OBJECT
+
+    if (type(new) is not float) and (type(new) is not int):
+        return OBJECT
+
+    if (ty is float) or (ty is renpy.atl.float_or_none):
+        return FLOAT
+
+    if ty is int:
+        return INT
+
+    return OBJECT
+
+
+cdef class Interpolator:
+    """
+    This is the compiled form of the properties an ATL interpolation
+    changes linearly. Numeric properties are interpolated with C doubles,
+    while everything else goes through renpy.atl.interpolate.
+
+    This isn't saved. Interpolation keeps the dictionary it was compiled
+    from in its state, and caches the Interpolator beside it.
+    """
+
+    # The number of properties.
+    cdef int count
+
+    # The names of the properties, in the order they're set.
+    cdef list names
+
+    # The kind of each property.
+    cdef int *kind
+
+    # The old and new values of numeric properties.
+    cdef double *old
+    cdef double *new
+
+    # For properties of kind OBJECT, an (old, new, type) tuple. None for
+    # the others.
+    cdef list objects
+
+    def __cinit__(self):
+        self.kind = NULL
+        self.old = NULL
+        self.new = NULL
+
+    def __init__(self, dict linear):
+
+        cdef int i = 0
+        cdef int kind
+
+        self.count = len(linear)
+
+        self.names = [ ]
+        self.objects = [ ]
+
+        self.kind = <int *> malloc(self.count * sizeof(int))
+        self.old = <double *> malloc(self.count * sizeof(double))
+        self.new = <double *> malloc(self.count * sizeof(double))
+
+        properties = renpy.atl.PROPERTIES
+
+        for name, (old, new) in linear.items():
+
+            ty = properties[name]
+            kind = value_kind(old, new, ty)
+
+            self.names.append(name)
+            self.kind[i] = kind
+
+            if kind == OBJECT:
+                self.objects.append((old, new, ty))
+                self.old[i] = 0.0
+                self.new[i] = 0.0
+
+            else:
+                self.objects.append(None)
+
+                if old is None:
+                    self.old[i] = 0.0
+                else:
+                    self.old[i] = old
+
+                self.new[i] = new
+
+            i += 1
+
+    def __dealloc__(self):
+        free(self.kind)
+        free(self.old)
+        free(self.new)
+
+    def apply(self, state, complete):
+        """
+        Sets each property on `state` to the value it has when the
+        interpolation is `complete` of the way done.
+        """
+
+        cdef int i
+        cdef double t = complete
+        cdef double v
+
+        for 0 <= i < self.count:
+
+            if self.kind[i] == OBJECT:
+                old, new, ty = self.objects[i]
+                value = renpy.atl.interpolate(complete, old, new, ty)
+
+            else:
+                v = self.old[i] + t * (self.new[i] - self.old[i])
+
+                if self.kind[i] == INT:
+                    value = int(v)
+                elif self.kind[i] == ABSOLUTE:
+                    value = renpy.display.core.absolute(v)
+                else:
+                    value = v
+
+            setattr(state, self.names[i], value)
@@ -66,6 +66,15 @@ rollback_enabled = True
 # If the rollback is longer than this, we may trim it.
 rollback_length = 128
 
+# If not None, the rollback log is trimmed when its estimated size is
+# more than this many bytes.
+rollback_memory_limit = None
+
+# If True, the whole store is compared with a copy taken at the start of
+# each statement to find what changed, which also finds changes made by
+# global statements in code Ren'Py didn't compile.
+diff_whole_store = False
+
 # If set to True, clicking while in rollback will keep the roll forward
 # buffer if the data has not changed.
 keep_rollback_data = False
@@ -506,6 +515,13 @@ voice_tag_callback = None
 # A list of callbacks that can be used to add JSON to save files.
 save_json_callbacks = [ ]
 
+# Should saves be compressed and written in a background thread?
+save_in_background = True
+
+# If not None, the size of the chunks the log of a save is split into, so
+# the chunks can be shared between saves.
+save_chunk_size = None
+
 # The duration of a longpress, in seconds.
 longpress_duration = .5
 
@@ -714,6 +730,11 @@ speaking_attribute = None
 # How many elements need to be in a list before we compress it for rollback.
 list_compression_length = 25
 
+# How many items need to be in a dict before we compress it for rollback,
+# or None to not compress dicts. Compressed dicts are pickled into saves as
+# renpy.python.CompressedDict, which older versions of Ren'Py can't load.
+dict_compression_length = None
+
 # How many elements of history are kept. None to disable history.
 history_length = None
 
@@ -1143,6 +1164,21 @@ mouse_displayable = None
 # The default bias for the GL level of detail.
 gl_lod_bias = -.5
 
+# Should gl2 draw unchanged layers from a cached texture?
+gl_cache_layers = False
+
+# The amount of texture memory, in megabytes, gl2 keeps around to be reused
+# by render to texture.
+gl_texture_pool_mb = 8
+
+# The number of pixels of an image gl2 uploads to the GPU each time it
+# readies a texture while idle.
+gl_texture_upload_pixels = 1024 * 1024
+
+# Images with a width and height no larger than this are packed into a
+# texture atlas by gl2. 0 disables the atlas.
+gl_atlas_max_size = 0
+
 # A dictionary from a tag (or None) to a function that adjusts the attributes
 # of that tag.
 adjust_attributes = { }
@@ -1715,10 +1715,14 @@ class Renderer(object):
             The value of self.can_block, from above.
         """
 
-    def mutated_surface(self, surf):
+    def mutated_surface(self, surf, rect=None):
         """
         Called to indicated that `surf` has changed and textures based on
         it should not be used.
+
+        `rect`
+            If not None, an (x, y, w, h) rectangle containing all the
+            pixels that changed.
         """
 
         if surf in self.texture_cache:
@@ -3779,6 +3783,9 @@ class Interface(object):
                 # Check for autoreload.
                 renpy.loader.check_autoreload()
 
+                # Report a background save that failed.
+                renpy.loadsave.check_saves()
+
                 for i in renpy.config.needs_redraw_callbacks:
                     if i():
                         needs_redraw = True
@@ -377,6 +377,9 @@ class Cache(object):
             if ce.time == self.time:
                 # If we're bigger than the limit, and there's nothing
                 # to remove, we should stop the preloading right away.
+                if renpy.display.draw is not None:
+                    renpy.display.draw.free_memory()
+
                 return False
 
             # Otherwise, kill off the given cache entry.
@@ -386,6 +389,9 @@ class Cache(object):
             if self.get_total_size() <= self.cache_limit:
                 break
 
+        if renpy.display.draw is not None:
+            renpy.display.draw.free_memory()
+
         return True
 
     def flush_file(self, fn):
@@ -47,8 +47,11 @@ class SpriteCache(renpy.object.Object):
     #
     # render - The render of child.
     #
-    # If true, then the render is simple enough it can just be appended to
+    # fast - If true, then the render is simple enough it can just be appended to
     # the manager's render's children list.
+    #
+    # batch_key - If not None, the render draws a single model that can be
+    # batched with other models that have the same key.
 
 
 class Sprite(renpy.object.Object):
@@ -127,6 +130,24 @@ class Sprite(renpy.object.Object):
         self.events = False
 
 
+def add_batch(rv, batch):
+    """
+    Adds `batch`, a list of (model, x, y) tuples that share a batch key, to
+    the render `rv`.
+    """
+
+    if not batch:
+        return
+
+    if len(batch) == 1:
+        child, x, y = batch[0]
+        rv.children.append((child, x, y, False, False))
+        return
+
+    for child in renpy.display.draw.batch_models(batch):
+        rv.children.append((child, 0, 0, False, False))
+
+
 class SpriteManager(renpy.display.core.Displayable):
     """
     :doc: sprites class
@@ -265,6 +286,13 @@ class SpriteManager(renpy.display.core.Displayable):
 
         events = False
 
+        # When the renderer supports models, runs of sprites that each draw
+        # part of the same texture are combined, so each run is drawn with
+        # a single call.
+        batching = renpy.display.render.models
+        batch = [ ]
+        batch_key = None
+
         for i in self.children:
 
             events |= i.events
@@ -281,8 +309,28 @@ class SpriteManager(renpy.display.core.Displayable):
                 cache.fast = (r.operation == BLIT) and (r.forward is None) and (r.alpha == 1.0) and (r.over == 1.0)
                 rv.depends_on(r)
 
+                cache.batch_key = None
+
+                if batching and cache.fast and (len(r.children) == 1) and not r.properties:
+                    cache.batch_key = renpy.display.draw.batch_key(r.children[0][0])
+
                 caches.append(cache)
 
+            if cache.batch_key is not None:
+
+                if cache.batch_key is not batch_key:
+                    add_batch(rv, batch)
+                    batch = [ ]
+                    batch_key = cache.batch_key
+
+                child, xo, yo, _focus, _main = r.children[0]
+                batch.append((child, xo + i.x, yo + i.y))
+                continue
+
+            add_batch(rv, batch)
+            batch = [ ]
+            batch_key = None
+
             if cache.fast:
                 for child, xo, yo, _focus, _main in r.children:
                     rv.children.append((child,
@@ -294,8 +342,11 @@ class SpriteManager(renpy.display.core.Displayable):
             else:
                 rv.subpixel_blit(r, (i.x, i.y))
 
+        add_batch(rv, batch)
+
         for i in caches:
             i.render = None
+            i.batch_key = None
 
         return rv
 
@@ -99,6 +99,11 @@ cdef class Render:
     # Used to cache the model.
     cdef public object cached_model
 
+    # Used to cache the bounding box of this Render and its children, as an
+    # (x0, y0, x1, y1) tuple. This is None if not computed yet, and False
+    # if the bounds are unknown.
+    cdef public object cached_bounds
+
     # True if the texture has been loaded.
     cdef public bint loaded
 
@@ -463,12 +463,17 @@ def focus_at_point(x, y):
         return renpy.display.focus.Focus(d, arg, None, None, None, None, screen)
 
 
-def mutated_surface(surf):
+def mutated_surface(surf, rect=None):
     """
     Called to indicate that the given surface has changed.
+
+    `rect`
+        If not None, an (x, y, w, h) rectangle containing all the pixels
+        that changed. Renderers that can may update only that part of
+        the texture.
     """
 
-    renpy.display.draw.mutated_surface(surf)
+    renpy.display.draw.mutated_surface(surf, rect)
 
 
 def render_screen(root, width, height):
@@ -715,6 +720,9 @@ cdef class Render:
         # Used to cache the model.
         self.cached_model = None
 
+        # Used to cache the bounding box of this Render and its children.
+        self.cached_bounds = None
+
         # Have the textures been loaded?
         self.loaded = False
 
@@ -763,6 +771,8 @@ cdef class Render:
         else:
             self.children.insert(index, (source, xo, yo, focus, main))
 
+        self.cached_bounds = None
+
         if isinstance(source, Render):
             self.depends_on_list.append(source)
             source.parents.add(self)
@@ -797,6 +807,8 @@ cdef class Render:
         else:
             self.children.insert(index, (source, xo, yo, focus, main))
 
+        self.cached_bounds = None
+
         if isinstance(source, Render):
             self.depends_on_list.append(source)
             source.parents.add(self)
@@ -831,6 +843,8 @@ cdef class Render:
         else:
             self.children.insert(index, (source, xo, yo, focus, main))
 
+        self.cached_bounds = None
+
         if isinstance(source, Render):
             self.depends_on_list.append(source)
             source.parents.add(self)
@@ -1527,107 +1541,136 @@ class Canvas(object):
     def __init__(self, surf): #@DuplicatedSignature
         self.surf = surf
 
+    def mutated(self, rect):
+        """
+        Tells the renderer that the area of the surface in `rect`, the
+        bounding box returned by a pygame.draw function, has changed.
+        """
+
+        if rect is not None:
+            rect = tuple(rect)
+
+        mutated_surface(self.surf, rect)
+
     def rect(self, color, rect, width=0):
 
         try:
             blit_lock.acquire()
-            pygame.draw.rect(self.surf,
-                             renpy.easy.color(color),
-                             rect,
-                             width)
+            rv = pygame.draw.rect(self.surf,
+                                  renpy.easy.color(color),
+                                  rect,
+                                  width)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def polygon(self, color, pointlist, width=0):
         try:
             blit_lock.acquire()
-            pygame.draw.polygon(self.surf,
-                                renpy.easy.color(color),
-                                pointlist,
-                                width)
+            rv = pygame.draw.polygon(self.surf,
+                                     renpy.easy.color(color),
+                                     pointlist,
+                                     width)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def circle(self, color, pos, radius, width=0):
 
         try:
             blit_lock.acquire()
-            pygame.draw.circle(self.surf,
-                               renpy.easy.color(color),
-                               pos,
-                               radius,
-                               width)
+            rv = pygame.draw.circle(self.surf,
+                                    renpy.easy.color(color),
+                                    pos,
+                                    radius,
+                                    width)
 
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def ellipse(self, color, rect, width=0):
         try:
             blit_lock.acquire()
-            pygame.draw.ellipse(self.surf,
-                                renpy.easy.color(color),
-                                rect,
-                                width)
+            rv = pygame.draw.ellipse(self.surf,
+                                     renpy.easy.color(color),
+                                     rect,
+                                     width)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
 
     def arc(self, color, rect, start_angle, stop_angle, width=1):
         try:
             blit_lock.acquire()
-            pygame.draw.arc(self.surf,
-                            renpy.easy.color(color),
-                            rect,
-                            start_angle,
-                            stop_angle,
-                            width)
+            rv = pygame.draw.arc(self.surf,
+                                 renpy.easy.color(color),
+                                 rect,
+                                 start_angle,
+                                 stop_angle,
+                                 width)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
 
     def line(self, color, start_pos, end_pos, width=1):
         try:
             blit_lock.acquire()
-            pygame.draw.line(self.surf,
-                             renpy.easy.color(color),
-                             start_pos,
-                             end_pos,
-                             width)
+            rv = pygame.draw.line(self.surf,
+                                  renpy.easy.color(color),
+                                  start_pos,
+                                  end_pos,
+                                  width)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def lines(self, color, closed, pointlist, width=1):
         try:
             blit_lock.acquire()
-            pygame.draw.lines(self.surf,
-                              renpy.easy.color(color),
-                              closed,
-                              pointlist,
-                              width)
+            rv = pygame.draw.lines(self.surf,
+                                   renpy.easy.color(color),
+                                   closed,
+                                   pointlist,
+                                   width)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def aaline(self, color, startpos, endpos, blend=1):
         try:
             blit_lock.acquire()
-            pygame.draw.aaline(self.surf,
-                               renpy.easy.color(color),
-                               startpos,
-                               endpos,
-                               blend)
+            rv = pygame.draw.aaline(self.surf,
+                                    renpy.easy.color(color),
+                                    startpos,
+                                    endpos,
+                                    blend)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def aalines(self, color, closed, pointlist, blend=1):
         try:
             blit_lock.acquire()
-            pygame.draw.aalines(self.surf,
-                                renpy.easy.color(color),
-                                closed,
-                                pointlist,
-                                blend)
+            rv = pygame.draw.aalines(self.surf,
+                                     renpy.easy.color(color),
+                                     closed,
+                                     pointlist,
+                                     blend)
         finally:
             blit_lock.release()
 
+        self.mutated(rv)
+
     def get_surface(self):
         return self.surf
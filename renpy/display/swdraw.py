@@ -916,7 +916,14 @@ class SWDraw(object):
 
         return False
 
-    def mutated_surface(self, surf):
+    def free_memory(self):
+        """
+        Called when the image cache frees memory.
+        """
+
+        return
+
+    def mutated_surface(self, surf, rect=None):
         """
         Called to indicate that the given surface has changed.
         """
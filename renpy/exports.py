@@ -1783,6 +1783,10 @@ def get_all_labels():
         if isinstance(i, basestring):
             rv.append(i)
 
+    for i in renpy.game.script.lazy_names.keys():
+        if isinstance(i, basestring):
+            rv.append(i)
+
     return renpy.python.RevertableSet(rv)
 
 
@@ -655,10 +655,13 @@ cdef class GLDraw:
         else:
             return False
 
-    def mutated_surface(self, surf):
+    def mutated_surface(self, surf, rect=None):
         if surf in self.texture_cache:
             del self.texture_cache[surf]
 
+    def free_memory(self):
+        return
+
     def load_texture(self, surf, transient=False, properties={}):
         """
         Loads a texture into memory.
@@ -82,4 +82,13 @@ cdef class GL2Draw:
     # The current FBO.
     cdef public GLuint current_fbo
 
+    # A map from the id of a layer Render to a (render, texture) tuple, for
+    # the layers drawn in the last frame. The texture is None if the layer
+    # isn't cached.
+    cdef dict layer_renders
+
+    # A weak map from a surface to a (weakref to texture, properties) tuple,
+    # so a surface that's mutated can update its texture in place.
+    cdef object texture_cache
+
     cdef void change_fbo(self, GLuint fbo)
@@ -54,11 +54,13 @@ from renpy.display.matrix cimport Matrix
 cimport renpy.gl2.gl2texture as gl2texture
 
 from renpy.gl2.gl2mesh cimport Mesh
+from renpy.gl2.gl2mesh2 cimport Mesh2
 from renpy.gl2.gl2mesh3 cimport Mesh3
 from renpy.gl2.gl2polygon cimport Polygon
 from renpy.gl2.gl2model cimport GL2Model
 
-from renpy.gl2.gl2texture import Texture, TextureLoader
+from renpy.gl2.gl2texture import Texture, TextureLoader, AtlasModel
+from renpy.gl2.gl2mesh import TEXTURE_LAYOUT
 from renpy.gl2.gl2shadercache import ShaderCache
 
 # Cache various externals, so we can use them more efficiently.
@@ -121,6 +123,12 @@ cdef class GL2Draw:
         # The shader cache,
         self.shader_cache = None
 
+        # The layer Renders drawn in the last frame.
+        self.layer_renders = { }
+
+        # The textures loaded from surfaces.
+        self.texture_cache = weakref.WeakKeyDictionary()
+
     def get_texture_size(self):
         """
         Returns the amount of memory locked up in textures.
@@ -429,6 +437,9 @@ cdef class GL2Draw:
             self.quit_fbo()
             self.shader_cache.clear()
 
+        # Cached layers were rendered at the old size.
+        self.layer_renders = { }
+
         if renpy.android or renpy.ios:
             pygame.display.get_window().recreate_gl_context()
 
@@ -509,6 +520,7 @@ cdef class GL2Draw:
 
         self.shader_cache.load()
         self.init_fbo()
+        self.texture_cache.clear()
         self.texture_loader.init()
 
     def resize(self):
@@ -722,15 +734,115 @@ cdef class GL2Draw:
         else:
             return False
 
-    def mutated_surface(self, surf):
-        return
+    def mutated_surface(self, surf, rect=None):
+        """
+        If `rect` is given, marks that part of the texture loaded from `surf`
+        as needing to be uploaded again. Otherwise, forgets the texture, so
+        the next load of the surface creates a new one. (This is what the
+        image cache does when it kills an image.)
+        """
+
+        t = self.texture_cache.get(surf, None)
+
+        if t is None:
+            return
+
+        if rect is None:
+            del self.texture_cache[surf]
+            return
+
+        tex = t[0]()
+
+        if tex is not None:
+            tex.mutated(surf, rect)
 
     def load_texture(self, surf, transient=False, properties={}):
         """
         Loads a texture into memory.
         """
 
-        return self.texture_loader.load_surface(surf, properties)
+        t = self.texture_cache.get(surf, None)
+
+        if (t is not None) and (t[1] == properties):
+            rv = t[0]()
+
+            if rv is not None:
+                return rv
+
+        rv = self.texture_loader.load_surface(surf, properties)
+
+        if isinstance(rv, (Texture, AtlasModel)):
+            self.texture_cache[surf] = (weakref.ref(rv), dict(properties))
+
+        return rv
+
+    def batch_key(self, what):
+        """
+        If `what` is a model that only draws part of a single texture with
+        the default texture shader, returns that texture, which is the key
+        used to batch it with other such models. Otherwise, returns None.
+        """
+
+        if not isinstance(what, GL2Model):
+            return None
+
+        if (what.reverse is not IDENTITY) or (what.shaders != ("renpy.texture",)):
+            return None
+
+        if not isinstance(what.mesh, Mesh2) or ((<Mesh> what.mesh).layout is not TEXTURE_LAYOUT):
+            return None
+
+        if what.properties:
+            return None
+
+        if isinstance(what, gl2texture.GLTexture):
+            return what
+
+        if (not what.uniforms) or (len(what.uniforms) != 1):
+            return None
+
+        rv = what.uniforms.get("tex0", None)
+
+        if isinstance(rv, gl2texture.GLTexture):
+            return rv
+
+        return None
+
+    def batch_models(self, list parts):
+        """
+        Combines `parts`, a list of (model, x, y) tuples where each model
+        has the same batch_key, into models that draw many parts with a
+        single call. Returns a list of models, which are placed at (0, 0)
+        and drawn in order.
+        """
+
+        cdef GL2Model model
+        cdef int points = 0
+
+        texture = self.batch_key(parts[0][0])
+
+        rv = [ ]
+        meshes = [ ]
+
+        width = 0
+        height = 0
+
+        for model, x, y in parts:
+
+            if points + model.mesh.points > 65535:
+                rv.append(batch_model(texture, meshes, width, height))
+                meshes = [ ]
+                points = 0
+
+            meshes.append((model.mesh, x, y))
+            points += model.mesh.points
+
+            width = max(width, x + model.width)
+            height = max(height, y + model.height)
+
+        rv.append(batch_model(texture, meshes, width, height))
+
+        return rv
 
     def ready_one_texture(self):
         """
@@ -815,6 +927,14 @@ cdef class GL2Draw:
         # Load all the textures and RTTs.
         self.load_all_textures(surf)
 
+        # Cache unchanged layers as textures.
+        if renpy.config.gl_cache_layers:
+            layer_renders = { }
+            self.cache_layers(surf, layer_renders)
+            self.layer_renders = layer_renders
+        else:
+            self.layer_renders = { }
+
         # Switch to the right FBO, and the right viewport.
         self.change_fbo(self.default_fbo)
 
@@ -833,12 +953,15 @@ cdef class GL2Draw:
 
         # Set up the default modes.
         glEnable(GL_BLEND)
-        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+        renpy.gl2.gl2shader.reset_state()
 
         # Use the context to draw the surface tree.
         context = GL2DrawingContext(self, w, h)
         context.draw(surf, transform)
 
+        renpy.plog(1, "drew {} nodes, culled {}, {} of {} layers cached", context.drawn, context.culled, context.cached_layers, len(self.layer_renders))
+        renpy.plog(1, "{} gl calls, {} avoided, {} textures bound", *renpy.gl2.gl2shader.get_gl_calls())
+
         self.flip()
 
         self.texture_loader.cleanup()
@@ -897,6 +1020,48 @@ cdef class GL2Draw:
                 uniforms)
 
 
+    def cache_layers(self, what, dict layer_renders):
+        """
+        Walks the surface tree until it finds the Renders of layers. A layer
+        that was drawn in the last frame is unchanged, as any change to it
+        kills the render cache and produces a new Render. Such a layer is
+        rendered to a texture, which draw_one uses in place of walking the
+        layer's children until the layer is redrawn.
+
+        `layer_renders`
+            A dictionary that the (render, texture) pairs for the layers
+            found are added to.
+        """
+
+        if not isinstance(what, Render):
+            return
+
+        cdef Render r = what
+
+        if r.mesh:
+            return
+
+        if r.layer_name is None:
+            for i in r.children:
+                self.cache_layers(i[0], layer_renders)
+
+            return
+
+        old = self.layer_renders.get(id(r), None)
+
+        if (old is None) or (old[0] is not r) or r.cache_killed:
+            layer_renders[id(r)] = (r, None)
+            return
+
+        texture = old[1]
+
+        # Drawing a text input sets interface.text_rect, so layers containing
+        # one are always walked.
+        if (texture is None) and not has_text_input(r):
+            texture = self.texture_loader.render_to_texture(r, { "mipmap" : False, "pixel_perfect" : True })
+
+        layer_renders[id(r)] = (r, texture)
+
     def render_to_texture(self, what, alpha=True, properties={}):
         """
         Renders `what` to a texture. The texture will have the drawable
@@ -955,7 +1120,7 @@ cdef class GL2Draw:
 
         # Set up the default modes.
         glEnable(GL_BLEND)
-        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+        renpy.gl2.gl2shader.reset_state()
 
         # Use the context to draw the surface tree.
         context = GL2DrawingContext(self, 1, 1)
@@ -1079,7 +1244,18 @@ cdef class GL2Draw:
 
         return rv
 
+    def free_memory(self):
+        """
+        Called when the image cache frees memory, to free memory that's been
+        kept for reuse.
+        """
+
+        if self.texture_loader is not None:
+            self.texture_loader.drain_pool()
+
     def kill_textures(self):
+        self.texture_cache.clear()
+
         if self.texture_loader is not None:
             self.texture_loader.cleanup()
 
@@ -1095,6 +1271,212 @@ cdef class GL2Draw:
         return (x, y)
 
 
+###############################################################################
+# Culling.
+
+# The bounds of something with nothing in it.
+cdef tuple EMPTY_BOUNDS = (float("inf"), float("inf"), float("-inf"), float("-inf"))
+
+cdef object transform_bounds(Matrix m, tuple bounds):
+    """
+    Returns the axis-aligned bounding box of `bounds` after it has been
+    transformed by `m`, or None if `m` has a perspective component.
+    """
+
+    cdef float x0, y0, x1, y1
+    cdef float ax, ay, bx, by, cx, cy, dx, dy
+
+    if m.wdx != 0.0 or m.wdy != 0.0 or m.wdw != 1.0:
+        return None
+
+    x0, y0, x1, y1 = bounds
+
+    if x0 > x1:
+        return bounds
+
+    m.transform2(&ax, &ay, x0, y0, 0, 1)
+    m.transform2(&bx, &by, x1, y0, 0, 1)
+    m.transform2(&cx, &cy, x1, y1, 0, 1)
+    m.transform2(&dx, &dy, x0, y1, 0, 1)
+
+    return (min(ax, bx, cx, dx), min(ay, by, cy, dy), max(ax, bx, cx, dx), max(ay, by, cy, dy))
+
+
+cdef GL2Model batch_model(texture, list meshes, width, height):
+    """
+    Returns a model that draws each (mesh, x, y) in `meshes` from `texture`.
+    """
+
+    return GL2Model((int(math.ceil(width)), int(math.ceil(height))), Mesh2.combine(meshes), ("renpy.texture",), { "tex0" : texture })
+
+
+cdef object model_bounds(GL2Model model):
+    """
+    Returns the bounds of the mesh of `model`, in the coordinates of the
+    Render containing it.
+    """
+
+    cdef Mesh mesh = model.mesh
+    cdef float *p
+    cdef float x0, y0, x1, y1
+    cdef int i
+
+    if mesh is None:
+        return None
+
+    if mesh.points == 0:
+        return EMPTY_BOUNDS
+
+    p = mesh.point_data
+
+    x0 = x1 = p[0]
+    y0 = y1 = p[1]
+
+    for 1 <= i < mesh.points:
+        p = mesh.point_data + i * mesh.point_size
+
+        if p[0] < x0:
+            x0 = p[0]
+        if p[0] > x1:
+            x1 = p[0]
+        if p[1] < y0:
+            y0 = p[1]
+        if p[1] > y1:
+            y1 = p[1]
+
+    rv = (x0, y0, x1, y1)
+
+    if model.reverse is not IDENTITY:
+        rv = transform_bounds(model.reverse, rv)
+
+    return rv
+
+
+cdef object compute_bounds(what):
+    """
+    Returns the bounds of `what` (a Render, GL2Model or Surface) in its own
+    coordinates, as an (x0, y0, x1, y1) tuple, or None if the bounds aren't
+    known. The bounds of a Render are cached, as Renders don't change once
+    they're drawn.
+
+    The bounds are of the geometry before shaders are applied, which is what
+    clipping crops.
+    """
+
+    cdef Render r
+    cdef float x0, y0, x1, y1
+    cdef float cx0, cy0, cx1, cy1
+
+    if isinstance(what, GL2Model):
+        return model_bounds(<GL2Model> what)
+
+    if isinstance(what, Surface):
+        w, h = what.get_size()
+        return (0.0, 0.0, w, h)
+
+    if not isinstance(what, Render):
+        return None
+
+    r = what
+
+    if r.cached_bounds is not None:
+        return r.cached_bounds or None
+
+    # Text inputs are never culled, as drawing one has the side effect of
+    # setting interface.text_rect.
+    if r.text_input:
+        r.cached_bounds = False
+        return None
+
+    if r.cached_model is not None:
+        children = [ (r.cached_model, 0, 0, False, False) ]
+    elif r.mesh:
+        r.cached_bounds = False
+        return None
+    else:
+        children = r.visible_children
+
+    has_reverse = (r.reverse is not None) and (r.reverse is not IDENTITY)
+
+    x0, y0, x1, y1 = EMPTY_BOUNDS
+
+    for child, cx, cy, focus, main in children:
+
+        bounds = compute_bounds(child)
+
+        if (bounds is not None) and has_reverse:
+            bounds = transform_bounds(r.reverse, bounds)
+
+        if bounds is None:
+            r.cached_bounds = False
+            return None
+
+        cx0, cy0, cx1, cy1 = bounds
+
+        if cx0 > cx1:
+            continue
+
+        x0 = min(x0, cx0 + cx)
+        y0 = min(y0, cy0 + cy)
+        x1 = max(x1, cx1 + cx)
+        y1 = max(y1, cy1 + cy)
+
+    if r.xclipping or r.yclipping:
+        x0 = max(x0, 0)
+        y0 = max(y0, 0)
+        x1 = min(x1, r.width)
+        y1 = min(y1, r.height)
+
+    if x0 > x1 or y0 > y1:
+        rv = EMPTY_BOUNDS
+    else:
+        rv = (x0, y0, x1, y1)
+
+    r.cached_bounds = rv
+    return rv
+
+
+cdef bint has_text_input(Render r):
+    """
+    Returns true if `r` or one of its children is a text input.
+    """
+
+    if r.text_input:
+        return True
+
+    for i in r.children:
+        if isinstance(i[0], Render) and has_text_input(i[0]):
+            return True
+
+    return False
+
+
+cdef bint outside_polygon(tuple bounds, Polygon p):
+    """
+    Returns true if `bounds` lies entirely outside the bounding box of `p`.
+    """
+
+    cdef float x0, y0, x1, y1
+    cdef float px0, py0, px1, py1
+    cdef int i
+
+    x0, y0, x1, y1 = bounds
+
+    if x0 > x1:
+        return True
+
+    px0 = px1 = p.point[0].x
+    py0 = py1 = p.point[0].y
+
+    for 1 <= i < p.points:
+        px0 = min(px0, p.point[i].x)
+        px1 = max(px1, p.point[i].x)
+        py0 = min(py0, p.point[i].y)
+        py1 = max(py1, p.point[i].y)
+
+    return (x1 < px0) or (x0 > px1) or (y1 < py0) or (y0 > py1)
+
+
 cdef class GL2DrawingContext:
     """
     This is an object that represents the state of the GL rendering
@@ -1113,6 +1495,15 @@ cdef class GL2DrawingContext:
 
     cdef bint debug
 
+    # The number of nodes (Renders, models, and surfaces) drawn, and the
+    # number of nodes skipped because they're entirely outside the clip
+    # polygon.
+    cdef public int drawn
+    cdef public int culled
+
+    # The number of layers drawn from a cached texture.
+    cdef public int cached_layers
+
     def __init__(self, GL2Draw draw, width, height, debug=False):
         self.gl2draw = draw
 
@@ -1121,6 +1512,10 @@ cdef class GL2DrawingContext:
 
         self.debug = debug
 
+        self.drawn = 0
+        self.culled = 0
+        self.cached_layers = 0
+
     def merge_properties(self, dict old, dict child):
         """
         Merges the child properties into the old properties,
@@ -1236,6 +1631,8 @@ cdef class GL2DrawingContext:
         cdef Polygon child_clip_polygon
         cdef Polygon new_clip_polygon
 
+        self.drawn += 1
+
         if isinstance(what, Surface):
             what = self.gl2draw.load_texture(what)
 
@@ -1246,6 +1643,15 @@ cdef class GL2DrawingContext:
         cdef Render r
         r = what
 
+        # Draw an unchanged layer from its cached texture.
+        if (r.layer_name is not None) and self.gl2draw.layer_renders:
+            layer = self.gl2draw.layer_renders.get(id(r), None)
+
+            if (layer is not None) and (layer[0] is r) and (layer[1] is not None):
+                self.cached_layers += 1
+                self.draw_model(layer[1], transform, clip_polygon, shaders, uniforms, properties)
+                return
+
         if r.text_input:
 
             tovirt = Matrix.cscreen_projection(self.gl2draw.virtual_size[0], self.gl2draw.virtual_size[1]).inverse() * transform
@@ -1326,6 +1732,14 @@ cdef class GL2DrawingContext:
                 if child_clip_polygon is not None:
                     child_clip_polygon = child_clip_polygon.multiply_matrix(r.forward)
 
+            # Skip children that would be entirely clipped away.
+            if child_clip_polygon is not None:
+                bounds = compute_bounds(child)
+
+                if (bounds is not None) and outside_polygon(bounds, child_clip_polygon):
+                    self.culled += 1
+                    continue
+
             self.draw_one(child, child_transform, child_clip_polygon, shaders, uniforms, child_properties)
 
 
@@ -18,20 +18,21 @@ required_functions = [
     "glClearColor",
     "glColorMask",
     "glCompileShader",
-    "glCopyTexImage2D",
+    "glCopyTexSubImage2D",
     "glCreateProgram",
     "glCreateShader",
     "glDeleteFramebuffers",
     "glDeleteRenderbuffers",
     "glDeleteShader",
     "glDeleteTextures",
+    "glDepthFunc",
+    "glDisable",
     "glDisableVertexAttribArray",
     "glDrawElements",
     "glEnable",
     "glEnableVertexAttribArray",
     "glFinish",
     "glFramebufferRenderbuffer",
-    "glFramebufferTexture2D",
     "glGenFramebuffers",
     "glGenRenderbuffers",
     "glGenTextures",
@@ -54,6 +55,7 @@ required_functions = [
     "glTexImage2D",
     "glTexParameterf",
     "glTexParameteri",
+    "glTexSubImage2D",
     "glUniform1f",
     "glUniform1i",
     "glUniform2f",
@@ -1,7 +1,8 @@
 from __future__ import print_function
 
 from libc.stdlib cimport malloc, free
-from libc.math cimport hypot
+from libc.string cimport memcpy
+from libc.math cimport hypot, fabs
 
 from renpy.gl2.gl2polygon cimport Polygon, Point2
 from renpy.gl2.gl2mesh cimport Mesh, AttributeLayout
@@ -212,6 +213,48 @@ cdef class Mesh2(Mesh):
 
         return rv
 
+    @staticmethod
+    def combine(list parts):
+        """
+        Returns a new Mesh2 containing each mesh in `parts`, a non-empty list
+        of (mesh, x, y) tuples, offset by (x, y). The meshes must share a
+        layout, and have fewer than 65536 points between them.
+        """
+
+        cdef Mesh2 m = parts[0][0]
+        cdef AttributeLayout layout = m.layout
+        cdef int stride = layout.stride
+        cdef int points = 0
+        cdef int triangles = 0
+        cdef int base
+        cdef int i
+        cdef float x
+        cdef float y
+
+        for m, x, y in parts:
+            points += m.points
+            triangles += m.triangles
+
+        cdef Mesh2 rv = Mesh2(layout, points, triangles)
+
+        for m, x, y in parts:
+
+            base = rv.points
+
+            for 0 <= i < m.points:
+                rv.point[base + i].x = m.point[i].x + x
+                rv.point[base + i].y = m.point[i].y + y
+
+            memcpy(rv.attribute + base * stride, m.attribute, m.points * stride * sizeof(float))
+
+            for 0 <= i < m.triangles * 3:
+                rv.triangle[rv.triangles * 3 + i] = m.triangle[i] + base
+
+            rv.points += m.points
+            rv.triangles += m.triangles
+
+        return rv
+
     cpdef Mesh2 crop(Mesh2 self, Polygon p):
         """
         Crops this mesh against Polygon `p`, and returns a new Mesh2.
@@ -424,13 +467,6 @@ cdef Mesh2 split_mesh(Mesh2 old, float x0, float y0, float x1, float y1):
     cdef int i
     cdef int op, np
 
-    cdef CropInfo *ci = <CropInfo *> malloc(sizeof(CropInfo) + old.points * sizeof(CropPoint))
-
-    ci.x0 = x0
-    ci.y0 = y0
-    ci.x1 = x1
-    ci.y1 = y1
-
     # Step 1: Determine what points are inside and outside the line.
 
     cdef bint all_inside
@@ -453,22 +489,31 @@ cdef Mesh2 split_mesh(Mesh2 old, float x0, float y0, float x1, float y1):
 
         if (lx * py - ly * px) > -0.000001:
             all_outside = False
-            ci.point[i].inside = True
         else:
             all_inside = False
-            ci.point[i].inside = False
 
     # Step 1a: Short circuit if all points are inside or out, otherwise
-    # allocate a new object.
+    # allocate the crop information and a new object.
 
     if all_outside:
-        free(ci)
         return Mesh2(old.layout, 0, 0)
 
     if all_inside:
-        free(ci)
         return old
 
+    cdef CropInfo *ci = <CropInfo *> malloc(sizeof(CropInfo) + old.points * sizeof(CropPoint))
+
+    ci.x0 = x0
+    ci.y0 = y0
+    ci.x1 = x1
+    ci.y1 = y1
+
+    for 0 <= i < old.points:
+        px = old.point[i].x - x0
+        py = old.point[i].y - y0
+
+        ci.point[i].inside = (lx * py - ly * px) > -0.000001
+
     cdef Mesh2 new = Mesh2(old.layout, old.points + old.triangles * 2, old.triangles * 2)
 
     # Step 2: Copy points that are inside.
@@ -531,6 +576,115 @@ cdef Mesh2 split_mesh(Mesh2 old, float x0, float y0, float x1, float y1):
     free(ci)
     return new
 
+cdef bint polygon_rectangle(Polygon p, float *x0, float *y0, float *x1, float *y1):
+    """
+    If `p` is an axis-aligned rectangle, stores its bounds in `x0`, `y0`,
+    `x1`, and `y1` and returns True. Otherwise, returns False.
+    """
+
+    cdef int i
+    cdef int j
+
+    if p.points != 4:
+        return False
+
+    j = 3
+
+    for 0 <= i < 4:
+        if (fabs(p.point[i].x - p.point[j].x) > 0.0001) and (fabs(p.point[i].y - p.point[j].y) > 0.0001):
+            return False
+
+        j = i
+
+    x0[0] = min(p.point[0].x, p.point[2].x)
+    x1[0] = max(p.point[0].x, p.point[2].x)
+    y0[0] = min(p.point[0].y, p.point[2].y)
+    y1[0] = max(p.point[0].y, p.point[2].y)
+
+    return True
+
+
+cdef Mesh2 crop_rectangle(Mesh2 m, float cx0, float cy0, float cx1, float cy1):
+    """
+    If `m` is a rectangle laid out the way Mesh2.rectangle and
+    Mesh2.texture_rectangle create them, with attributes that vary linearly
+    across it, crops it to the axis-aligned rectangle (cx0, cy0, cx1, cy1).
+    Otherwise, returns None.
+    """
+
+    cdef int i
+    cdef int j
+    cdef int stride = m.layout.stride
+
+    cdef Point2 *p = m.point
+    cdef float *a = m.attribute
+
+    if m.points != 4 or m.triangles != 2:
+        return None
+
+    if (m.triangle[0] != 0 or m.triangle[1] != 1 or m.triangle[2] != 2 or
+        m.triangle[3] != 0 or m.triangle[4] != 2 or m.triangle[5] != 3):
+        return None
+
+    if p[0].y != p[1].y or p[1].x != p[2].x or p[2].y != p[3].y or p[3].x != p[0].x:
+        return None
+
+    if p[0].x == p[1].x or p[0].y == p[3].y:
+        return None
+
+    # The attributes must be linear, so the two triangles agree.
+    for 0 <= i < stride:
+        if fabs(a[2 * stride + i] - (a[1 * stride + i] + a[3 * stride + i] - a[0 * stride + i])) > 0.000001:
+            return None
+
+    cdef float mx0 = min(p[0].x, p[1].x)
+    cdef float mx1 = max(p[0].x, p[1].x)
+    cdef float my0 = min(p[0].y, p[3].y)
+    cdef float my1 = max(p[0].y, p[3].y)
+
+    if mx0 >= cx0 and mx1 <= cx1 and my0 >= cy0 and my1 <= cy1:
+        return m
+
+    cx0 = max(cx0, mx0)
+    cx1 = min(cx1, mx1)
+    cy0 = max(cy0, my0)
+    cy1 = min(cy1, my1)
+
+    if cx0 >= cx1 or cy0 >= cy1:
+        return Mesh2(m.layout, 0, 0)
+
+    cdef Mesh2 rv = Mesh2(m.layout, 4, 2)
+
+    rv.points = 4
+
+    # Keep the corners in the same order as the original.
+    for 0 <= i < 4:
+        rv.point[i].x = cx0 if p[i].x == mx0 else cx1
+        rv.point[i].y = cy0 if p[i].y == my0 else cy1
+
+    # The fraction of the way from point 0 to points 1 and 3 each new point
+    # is, which is used to interpolate the attributes.
+    cdef float dx
+    cdef float dy
+
+    for 0 <= i < 4:
+        dx = (rv.point[i].x - p[0].x) / (p[1].x - p[0].x)
+        dy = (rv.point[i].y - p[0].y) / (p[3].y - p[0].y)
+
+        for 0 <= j < stride:
+            rv.attribute[i * stride + j] = (
+                a[j] +
+                dx * (a[1 * stride + j] - a[j]) +
+                dy * (a[3 * stride + j] - a[j]))
+
+    rv.triangles = 2
+
+    for 0 <= i < 6:
+        rv.triangle[i] = m.triangle[i]
+
+    return rv
+
+
 cdef Mesh2 crop_mesh(Mesh2 m, Polygon p):
     """
     Returns a new Mesh that only the portion of `d` that is entirely
@@ -540,6 +694,16 @@ cdef Mesh2 crop_mesh(Mesh2 m, Polygon p):
     cdef int i
     cdef int j
 
+    cdef float x0, y0, x1, y1
+
+    # Fast path: rectangles clipped to axis-aligned rectangles, which is
+    # what clipping under unit-aligned transforms produces.
+    if polygon_rectangle(p, &x0, &y0, &x1, &y1):
+        rv = crop_rectangle(m, x0, y0, x1, y1)
+
+        if rv is not None:
+            return rv
+
     p.ensure_winding()
 
     rv = m
@@ -15,6 +15,7 @@ cdef class Program:
     cdef public dict uniforms
 
     cdef public list attributes
+    cdef unsigned int attribute_mask
 
     cdef public int samplers
 
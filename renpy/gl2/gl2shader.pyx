@@ -1,5 +1,6 @@
 from renpy.uguu.gl cimport *
 from libc.stdlib cimport malloc, free
+from libc.string cimport memcmp, memcpy
 
 from renpy.gl2.gl2mesh cimport Mesh
 from renpy.gl2.gl2texture cimport GLTexture
@@ -17,15 +18,151 @@ GLSL_PRECISIONS = {
     }
 
 
+################################################################################
+# Shadow state.
+#
+# This tracks the OpenGL state that programs set, so calls that wouldn't
+# change that state can be skipped. The state is only tracked between calls
+# to reset_state(), which needs to be called before drawing if other code
+# might have changed it.
+
+DEF MAX_ATTRIBUTES = 32
+DEF MAX_TEXTURE_UNITS = 16
+
+# A texture number that means the texture bound to a unit isn't known.
+DEF UNKNOWN_TEXTURE = 0xffffffff
+
+# The program in use, or 0 if not known.
+cdef GLuint current_program = 0
+
+# A bitmask of the vertex attribute arrays that are enabled.
+cdef unsigned int enabled_attributes = 0
+
+# The active texture unit, or -1 if not known.
+cdef int active_unit = -1
+
+# The texture bound to each texture unit.
+cdef GLuint bound_textures[MAX_TEXTURE_UNITS]
+
+# The blend_func tuple in use.
+cdef object current_blend = None
+
+DEFAULT_BLEND = (GL_FUNC_ADD, GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_FUNC_ADD, GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+
+# The number of calls to OpenGL that were made and avoided by the shadow
+# state, and the number of textures bound, since get_gl_calls was last
+# called.
+cdef int gl_calls = 0
+cdef int gl_calls_avoided = 0
+cdef int textures_bound = 0
+
+def reset_state():
+    """
+    Marks the shadowed state as unknown, disables the vertex attribute arrays
+    that programs enabled, and sets the default blend mode.
+    """
+
+    global current_program, enabled_attributes, active_unit, current_blend
+
+    cdef int i
+
+    for 0 <= i < MAX_ATTRIBUTES:
+        if enabled_attributes & ((<unsigned int> 1) << i):
+            glDisableVertexAttribArray(i)
+
+    for 0 <= i < MAX_TEXTURE_UNITS:
+        bound_textures[i] = UNKNOWN_TEXTURE
+
+    current_program = 0
+    enabled_attributes = 0
+    active_unit = -1
+
+    glBlendEquation(GL_FUNC_ADD)
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+    current_blend = DEFAULT_BLEND
+
+def get_gl_calls():
+    """
+    Returns the number of OpenGL calls made and avoided by programs, and the
+    number of textures they bound, since this was last called, and resets
+    those counts.
+    """
+
+    global gl_calls, gl_calls_avoided, textures_bound
+
+    rv = (gl_calls, gl_calls_avoided, textures_bound)
+
+    gl_calls = 0
+    gl_calls_avoided = 0
+    textures_bound = 0
+
+    return rv
+
+cdef void use_program(GLuint program):
+    global current_program, gl_calls, gl_calls_avoided
+
+    if program == current_program:
+        gl_calls_avoided += 1
+        return
+
+    glUseProgram(program)
+    current_program = program
+    gl_calls += 1
+
+cdef void set_active_unit(int unit):
+    global active_unit, gl_calls, gl_calls_avoided
+
+    if unit == active_unit:
+        gl_calls_avoided += 1
+        return
+
+    glActiveTexture(GL_TEXTURE0 + unit)
+    active_unit = unit
+    gl_calls += 1
+
+cdef void bind_texture(int unit, GLuint texture):
+    global gl_calls, gl_calls_avoided, textures_bound
+
+    if unit < MAX_TEXTURE_UNITS and bound_textures[unit] == texture:
+        gl_calls_avoided += 1
+        return
+
+    set_active_unit(unit)
+    glBindTexture(GL_TEXTURE_2D, texture)
+    gl_calls += 1
+    textures_bound += 1
+
+    if unit < MAX_TEXTURE_UNITS:
+        bound_textures[unit] = texture
+
+cdef void set_blend(blend):
+    global current_blend, gl_calls, gl_calls_avoided
+
+    if blend == current_blend:
+        gl_calls_avoided += 2
+        return
+
+    rgb_eq, src_rgb, dst_rgb, alpha_eq, src_alpha, dst_alpha = blend
+    glBlendEquationSeparate(rgb_eq, alpha_eq)
+    glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha)
+    current_blend = blend
+    gl_calls += 2
+
+################################################################################
+
 cdef class Uniform:
     cdef Program program
     cdef GLint location
     cdef bint ready
 
+    # The value last assigned to this uniform, which is kept by the program.
+    cdef object last
+
     def __init__(self, program, location):
         self.program = program
         self.location = location
         self.ready = False
+        self.last = None
 
     cdef void assign(self, data):
         return
@@ -34,25 +171,76 @@ cdef class Uniform:
         self.ready = False
         return
 
+    cdef bint unchanged(self, data):
+        """
+        Returns true if `data` is the value the uniform already has, and
+        records it otherwise.
+        """
+
+        global gl_calls, gl_calls_avoided
+
+        if data == self.last:
+            gl_calls_avoided += 1
+            return True
+
+        # Lists can be changed in place, so aren't kept.
+        if type(data) is list:
+            self.last = None
+        else:
+            self.last = data
+
+        gl_calls += 1
+        return False
+
 cdef class UniformFloat(Uniform):
     cdef void assign(self, data):
+        if self.unchanged(data):
+            return
+
         glUniform1f(self.location, data)
 
 cdef class UniformVec2(Uniform):
     cdef void assign(self, data):
+        if self.unchanged(data):
+            return
+
         glUniform2f(self.location, data[0], data[1])
 
 cdef class UniformVec3(Uniform):
     cdef void assign(self, data):
+        if self.unchanged(data):
+            return
+
         glUniform3f(self.location, data[0], data[1], data[2])
 
 cdef class UniformVec4(Uniform):
     cdef void assign(self, data):
+        if self.unchanged(data):
+            return
+
         glUniform4f(self.location, data[0], data[1], data[2], data[3])
 
 cdef class UniformMat4(Uniform):
+
+    # A copy of the last matrix assigned, as matrices are compared by
+    # value.
+    cdef float last_m[16]
+    cdef bint has_last
+
     cdef void assign(self, data):
-        glUniformMatrix4fv(self.location, 1, GL_FALSE, (<Matrix> data).m)
+        global gl_calls, gl_calls_avoided
+
+        cdef Matrix m = data
+
+        if self.has_last and memcmp(self.last_m, m.m, 16 * sizeof(float)) == 0:
+            gl_calls_avoided += 1
+            return
+
+        memcpy(self.last_m, m.m, 16 * sizeof(float))
+        self.has_last = True
+
+        glUniformMatrix4fv(self.location, 1, GL_FALSE, m.m)
+        gl_calls += 1
 
 cdef class UniformSampler2D(Uniform):
     cdef int sampler
@@ -63,14 +251,15 @@ cdef class UniformSampler2D(Uniform):
         program.samplers += 1
 
     cdef void assign(self, data):
-        glActiveTexture(GL_TEXTURE0 + self.sampler)
-        glUniform1i(self.location, self.sampler)
+
+        if not self.unchanged(self.sampler):
+            glUniform1i(self.location, self.sampler)
 
         if isinstance(data, GLTexture):
-            glBindTexture(GL_TEXTURE_2D, data.number)
+            bind_texture(self.sampler, data.number)
             self.program.set_uniform("res{}".format(self.sampler), (data.texture_width, data.texture_height))
         else:
-            glBindTexture(GL_TEXTURE_2D, data)
+            bind_texture(self.sampler, data)
 
 
 
@@ -93,6 +282,38 @@ cdef class Attribute:
         self.location = location
         self.size = size
 
+
+cdef void enable_attributes(unsigned int mask, list attributes):
+    """
+    Enables the vertex attribute arrays in `mask`, which are the locations of
+    `attributes`, and disables the rest.
+    """
+
+    global enabled_attributes, gl_calls, gl_calls_avoided
+
+    cdef Attribute a
+    cdef int i
+    cdef unsigned int disable = enabled_attributes & ~mask
+
+    for a in attributes:
+        if a.location >= MAX_ATTRIBUTES:
+            glEnableVertexAttribArray(a.location)
+            gl_calls += 1
+        elif enabled_attributes & ((<unsigned int> 1) << a.location):
+            gl_calls_avoided += 1
+        else:
+            glEnableVertexAttribArray(a.location)
+            gl_calls += 1
+
+    if disable:
+        for 0 <= i < MAX_ATTRIBUTES:
+            if disable & ((<unsigned int> 1) << i):
+                glDisableVertexAttribArray(i)
+                gl_calls += 1
+
+    enabled_attributes = mask
+
+
 ATTRIBUTE_TYPES = {
     "float" : 1,
     "vec2" : 2,
@@ -125,6 +346,9 @@ cdef class Program:
         # A list of Attribute objects
         self.attributes = [ ]
 
+        # A bitmask of the attribute locations.
+        self.attribute_mask = 0
+
         # The number of samplers that have been added.
         self.samplers = 0
 
@@ -186,6 +410,9 @@ cdef class Program:
                 if location >= 0:
                     self.attributes.append(Attribute(name, location, types[type]))
 
+                    if location < MAX_ATTRIBUTES:
+                        self.attribute_mask |= ((<unsigned int> 1) << location)
+
     cdef GLuint load_shader(self, GLenum shader_type, source) except? 0:
         """
         This loads a shader into the GPU, and returns the number.
@@ -250,7 +477,7 @@ cdef class Program:
         raise Exception("Shader {} has not been given {} {}.".format(self.name, kind, name))
 
     def start(self):
-        glUseProgram(self.program)
+        use_program(self.program)
 
     def set_uniform(self, name, value):
         cdef Uniform u
@@ -274,6 +501,8 @@ cdef class Program:
 
     def draw(self, Mesh mesh, dict properties):
 
+        global gl_calls
+
         cdef Attribute a
         cdef Uniform u
         cdef int i
@@ -292,7 +521,7 @@ cdef class Program:
 
                 glVertexAttribPointer(a.location, a.size, GL_FLOAT, GL_FALSE, mesh.layout.stride * sizeof(float), mesh.attribute + <int> offset)
 
-            glEnableVertexAttribArray(a.location)
+        enable_attributes(self.attribute_mask, self.attributes)
 
         for name, u in self.uniforms.iteritems():
             if not u.ready:
@@ -308,39 +537,34 @@ cdef class Program:
                 magnify, minify = TEXTURE_SCALING[properties["texture_scaling"]]
 
                 for 0 <= i < self.samplers:
-                    glActiveTexture(GL_TEXTURE0 + i)
+                    set_active_unit(i)
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magnify)
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minify)
 
-            if "blend_func" in properties:
-                rgb_eq, src_rgb, dst_rgb, alpha_eq, src_alpha, dst_alpha = properties["blend_func"]
-                glBlendEquationSeparate(rgb_eq, alpha_eq)
-                glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha)
+        # Draws without a blend_func use the default blend mode, unless the
+        # caller has changed it since reset_state.
+        set_blend(properties.get("blend_func", DEFAULT_BLEND))
 
         glDrawElements(GL_TRIANGLES, 3 * mesh.triangles, GL_UNSIGNED_SHORT, mesh.triangle)
+        gl_calls += 1
 
         if len(properties) > 1:
 
             if "texture_scaling" in properties:
                 for 0 <= i < self.samplers:
-                    glActiveTexture(GL_TEXTURE0 + i)
+                    set_active_unit(i)
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR)
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST)
 
             if "color_mask" in properties:
                 glColorMask(True, True, True, True)
 
-            if "blend_func" in properties:
-                glBlendEquation(GL_FUNC_ADD)
-                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
-
 
     def finish(Program self):
-        cdef Attribute a
         cdef Uniform u
 
-        for a in self.attributes:
-            glDisableVertexAttribArray(a.location)
+        # The attribute arrays are left enabled, and are disabled when a
+        # program that doesn't use them starts drawing.
 
         for u in self.uniforms.itervalues():
             u.finish()
@@ -32,9 +32,25 @@ cdef class TextureLoader:
     # All the texture number currently allocated by this loader.
     cdef set allocated
 
-    # A list of (number, generation) pairs for textures that need to be freed.
+    # A list of (number, pool key) pairs for textures that need to be freed.
     cdef list free_list
 
+    # A map from a (width, height, max mipmap level) pool key to a list of
+    # the numbers of unused textures with storage of that size, which can be
+    # reused by render to texture.
+    cdef dict texture_pool
+
+    # The number of bytes of storage in texture_pool.
+    cdef long texture_pool_size
+
+    # True if the texture pool should be emptied at the next cleanup.
+    cdef bint drain_texture_pool
+
+    # The number of render to texture textures that were taken from the
+    # pool, and that had to be allocated, since the last cleanup.
+    cdef int pool_reused
+    cdef int pool_allocated
+
     # The total size (in bytes) of all the textures that have been allocated
     # but not deallocated.
     cdef int total_texture_size
@@ -45,6 +61,21 @@ cdef class TextureLoader:
     # The queue of textures that need to be loaded.
     cdef object texture_load_queue
 
+    # A weakref to the texture that's partway through being uploaded by
+    # ready_one_texture, or None.
+    cdef object uploading
+
+    # The longest time, in seconds, a single texture upload took since the
+    # last cleanup.
+    cdef double max_upload_time
+
+    # A map from whether images are mipmapped to the atlas page images are
+    # being packed into.
+    cdef dict atlas_pages
+
+    # A weak set of every atlas page that's still in use.
+    cdef object atlas_live
+
     # The maximum size of a texture.
     cdef GLint max_texture_width
     cdef GLint max_texture_height
@@ -73,4 +104,18 @@ cdef class GLTexture(GL2Model):
     cdef public int texture_width
     cdef public int texture_height
 
+    # While the surface is being uploaded, the number of the texture holding
+    # the uploaded (non-premultiplied) pixels, and the number of rows that
+    # have been uploaded to it.
+    cdef GLuint upload_number
+    cdef int uploaded_rows
+
+    # If the surface of a loaded texture has been mutated, the (x0, y0, x1,
+    # y1) rectangle that needs to be uploaded again. Otherwise None.
+    cdef object dirty
+
+    # If not None, the pool key this texture's storage is returned to the
+    # texture pool with when it's freed.
+    cdef object pool_key
+
     cpdef subsurface(GLTexture self, t)
@@ -56,28 +56,85 @@ cdef GLenum RGBA8 = 0x8058
 cdef GLenum TEXTURE_MAX_ANISOTROPY_EXT = 0x84FE
 cdef GLenum MAX_TEXTURE_MAX_ANISOTROPY_EXT = 0x84FF
 
+# The width and height of an atlas page.
+DEF ATLAS_SIZE = 1024
+
+# The number of pixels of an image's edge that are repeated around it in the
+# atlas, so bilinear filtering doesn't pick up pixels from neighboring images.
+DEF ATLAS_GUTTER = 2
+
+# The number of mipmap levels used by mipmapped atlas pages, and the gutter
+# used on those pages. Images are placed on a grid of ATLAS_MIPMAP_GUTTER
+# pixels, which is twice the size of a texel at the last level, so filtering
+# at each level only reads an image and its gutter. Smaller levels would mix
+# images together, so they aren't sampled.
+DEF ATLAS_MIPMAP_LEVELS = 2
+DEF ATLAS_MIPMAP_GUTTER = 8
+
 ################################################################################
 
+cdef long pool_key_size(tuple key):
+    """
+    Returns the number of bytes of storage used by a texture with pool
+    key `key`, including all mipmap levels.
+    """
+
+    cdef int tw, th, max_level
+    cdef int level = 0
+    cdef long rv = 0
+
+    tw, th, max_level = key
+
+    while True:
+        rv += tw * th * 4
+
+        if tw == 1 and th == 1:
+            break
+
+        tw = max(tw >> 1, 1)
+        th = max(th >> 1, 1)
+        level += 1
+
+        if level > max_level:
+            break
+
+    return rv
+
+
 cdef class TextureLoader:
 
     def __init__(TextureLoader self, GL2Draw draw):
         self.allocated = set()
         self.free_list = [ ]
+        self.texture_pool = { }
+        self.texture_pool_size = 0
+        self.drain_texture_pool = False
+        self.pool_reused = 0
+        self.pool_allocated = 0
         self.total_texture_size = 0
         self.texture_load_queue = weakref.WeakSet()
+        self.uploading = None
+        self.max_upload_time = 0
+        self.atlas_pages = { }
+        self.atlas_live = weakref.WeakSet()
         self.draw = draw
 
     def init(self):
 
-        if self.allocated:
+        if self.allocated or self.texture_pool:
             self.quit()
 
         self.ftl_program = self.draw.shader_cache.get(("renpy.ftl",))
 
         self.allocated = set()
         self.free_list = [ ]
+        self.texture_pool = { }
+        self.texture_pool_size = 0
         self.total_texture_size = 0
         self.texture_load_queue = weakref.WeakSet()
+        self.uploading = None
+        self.atlas_pages = { }
+        self.atlas_live = weakref.WeakSet()
 
         glGetFloatv(MAX_TEXTURE_MAX_ANISOTROPY_EXT, &self.max_anisotropy)
 
@@ -92,14 +149,35 @@ cdef class TextureLoader:
             texnums[0] = texture_number
             glDeleteTextures(1, texnums)
 
+        for l in self.texture_pool.values():
+            for texture_number in l:
+                texnums[0] = texture_number
+                glDeleteTextures(1, texnums)
+
         self.allocated = set()
+        self.texture_pool = { }
+        self.texture_pool_size = 0
 
     def get_texture_size(self):
         """
-        Returns the amount of memory locked up in textures.
+        Returns the amount of memory locked up in textures, including the
+        texture pool.
+        """
+
+        pooled = 0
+
+        for l in self.texture_pool.values():
+            pooled += len(l)
+
+        return self.total_texture_size + self.texture_pool_size, len(self.allocated) + pooled
+
+    def drain_pool(self):
+        """
+        Called when the image cache frees memory, to empty the texture pool
+        at the next cleanup. This may be called from any thread.
         """
 
-        return self.total_texture_size, len(self.allocated)
+        self.drain_texture_pool = True
 
     def load_one_surface(self, surf, bl, bt, br, bb, properties):
         """
@@ -108,6 +186,12 @@ cdef class TextureLoader:
 
         size = surf.get_size()
 
+        if not (bl or bt or br or bb):
+            rv = self.load_atlas_surface(surf, properties)
+
+            if rv is not None:
+                return rv
+
         rv = Texture(size, self)
         rv.from_surface(surf, properties)
 
@@ -131,6 +215,66 @@ cdef class TextureLoader:
 
         return rv
 
+    def load_atlas_surface(self, surf, properties):
+        """
+        If `surf` is small enough, packs it into a page of the texture atlas,
+        and returns a model that draws it. Otherwise, returns None.
+
+        A page is freed when every model drawing from it has been freed, as
+        happens when the image cache kills the images on it.
+        """
+
+        w, h = surf.get_size()
+
+        limit = renpy.config.gl_atlas_max_size
+
+        if (w > limit) or (h > limit) or (not w) or (not h):
+            return None
+
+        # Images that need other texture parameters get their own texture.
+        for k in properties:
+            if k != "mipmap":
+                return None
+
+        key = bool(properties.get("mipmap", True))
+
+        if key:
+            gutter = ATLAS_MIPMAP_GUTTER
+        else:
+            gutter = ATLAS_GUTTER
+
+        # Round the allocation up to a multiple of the gutter, so every image
+        # starts on the gutter grid.
+        aw = (w + 2 * gutter + gutter - 1) // gutter * gutter
+        ah = (h + 2 * gutter + gutter - 1) // gutter * gutter
+
+        page = self.atlas_pages.get(key, None)
+        pos = None
+
+        if page is not None:
+            pos = page.allocate(aw, ah)
+
+        if pos is None:
+            page = AtlasTexture((ATLAS_SIZE, ATLAS_SIZE), self, dict(properties), gutter)
+            self.atlas_pages[key] = page
+            self.atlas_live.add(page)
+
+            pos = page.allocate(aw, ah)
+
+        x, y = pos
+        page.pending.append((surf, x, y))
+
+        rv = AtlasModel(page, x, y, w, h)
+
+        x += gutter
+        y += gutter
+
+        rv.mesh = Mesh2.texture_rectangle(
+            0.0, 0.0, w, h,
+            1.0 * x / ATLAS_SIZE, 1.0 * y / ATLAS_SIZE, 1.0 * (x + w) / ATLAS_SIZE, 1.0 * (y + h) / ATLAS_SIZE)
+
+        return rv
+
     def texture_axis(self, length, limit, border):
         """
         Splits `length` up into multiple textures.
@@ -212,36 +356,118 @@ cdef class TextureLoader:
         """
 
         cdef GLuint texnums[1]
+        cdef long size
+        cdef long budget = renpy.config.gl_texture_pool_mb * 1024 * 1024
 
-        for texture_number in self.free_list:
-            texnums[0] = texture_number
-            glDeleteTextures(1, texnums)
+        for texture_number, key in self.free_list:
 
             if texture_number not in self.allocated:
                 print("Leaking texture:", texture_number)
 
+            elif key is not None:
+                size = pool_key_size(key)
+
+                # Keep the storage around to be reused, if it fits.
+                if self.texture_pool_size + size <= budget:
+                    self.texture_pool.setdefault(key, [ ]).append(texture_number)
+                    self.texture_pool_size += size
+                    self.allocated.discard(texture_number)
+                    continue
+
+            texnums[0] = texture_number
+            glDeleteTextures(1, texnums)
+
             self.allocated.discard(texture_number)
 
         self.free_list = [ ]
 
+        if self.drain_texture_pool:
+            self.drain_texture_pool = False
+
+            for l in self.texture_pool.values():
+                for texture_number in l:
+                    texnums[0] = texture_number
+                    glDeleteTextures(1, texnums)
+
+            self.texture_pool = { }
+            self.texture_pool_size = 0
+
+        if self.pool_reused or self.pool_allocated:
+            renpy.plog(1, "texture pool reused {}, allocated {}, {} bytes pooled", self.pool_reused, self.pool_allocated, self.texture_pool_size)
+
+        if self.max_upload_time:
+            renpy.plog(1, "longest texture upload took {:.1f}ms", self.max_upload_time * 1000)
+
+        if self.atlas_live:
+            renpy.plog(1, "texture atlas holds {} pages, {} bytes", len(self.atlas_live), len(self.atlas_live) * ATLAS_SIZE * ATLAS_SIZE * 4)
+
+        self.pool_reused = 0
+        self.pool_allocated = 0
+        self.max_upload_time = 0
+
+    def get_pooled_texture(self, tuple key):
+        """
+        Returns the number of a texture with storage matching `key` from
+        the texture pool, or 0 if there isn't one.
+        """
+
+        l = self.texture_pool.get(key, None)
+
+        if not l:
+            self.pool_allocated += 1
+            return 0
+
+        rv = l.pop()
+
+        if not l:
+            del self.texture_pool[key]
+
+        self.texture_pool_size -= pool_key_size(key)
+        self.pool_reused += 1
+
+        return rv
+
 
     def ready_one_texture(self):
         """
-        Called by GL2Draw to implement ready_one_texture.
+        Called by GL2Draw to implement ready_one_texture. A large texture is
+        uploaded config.gl_texture_upload_pixels at a time, in chunks of
+        rows, over multiple calls, and becomes ready once every row has been
+        uploaded.
         """
 
-        while True:
+        start = time.time()
+
+        try:
+
+            while True:
+
+                tex = None
+
+                if self.uploading is not None:
+                    tex = self.uploading()
+                    self.uploading = None
+
+                if tex is None:
+                    try:
+                        tex = self.texture_load_queue.pop()
+                    except KeyError:
+                        return False
 
-            try:
-                tex = self.texture_load_queue.pop()
-            except KeyError:
-                return False
+                if tex.loaded:
+                    continue
+
+                rows = max(1, renpy.config.gl_texture_upload_pixels // max(tex.width, 1))
+
+                if tex.upload(rows):
+                    tex.load()
+                else:
+                    self.uploading = weakref.ref(tex)
 
-            if not tex.loaded:
-                tex.load()
                 return True
 
-        return False
+        finally:
+            self.max_upload_time = max(self.max_upload_time, time.time() - start)
 
 cdef class GLTexture(GL2Model):
     """
@@ -268,6 +494,16 @@ cdef class GLTexture(GL2Model):
         # True if the texture has been loaded into OpenGL, False otherwise.
         self.loaded = False
 
+        # The pool key, if this texture's storage came from the pool.
+        self.pool_key = None
+
+        # The texture the surface is uploaded to before being premultiplied.
+        self.upload_number = 0
+        self.uploaded_rows = 0
+
+        # The part of the surface that's changed since it was loaded.
+        self.dirty = None
+
         # Used for loading surfaces.
         self.surface = None
 
@@ -291,6 +527,37 @@ cdef class GLTexture(GL2Model):
 
         self.loader.texture_load_queue.add(self)
 
+    def mutated(GLTexture self, surface, rect):
+        """
+        Called when the (x, y, w, h) rectangle `rect` of `surface`, which
+        this texture was loaded from, has changed. Only that part of the
+        texture is updated when the texture is next loaded.
+        """
+
+        if not self.loaded:
+            self.surface = surface
+            self.uploaded_rows = 0
+            return
+
+        x, y, w, h = rect
+        x0 = max(x, 0)
+        y0 = max(y, 0)
+        x1 = min(x + w, self.width)
+        y1 = min(y + h, self.height)
+
+        if x1 <= x0 or y1 <= y0:
+            return
+
+        if self.dirty is not None:
+            dx0, dy0, dx1, dy1 = self.dirty
+            x0 = min(x0, dx0)
+            y0 = min(y0, dy0)
+            x1 = max(x1, dx1)
+            y1 = max(y1, dy1)
+
+        self.dirty = (x0, y0, x1, y1)
+        self.surface = surface
+
     def from_render(GLTexture self, what, properties):
         """
         This renders `what` to this texture.
@@ -326,8 +593,6 @@ cdef class GLTexture(GL2Model):
 
         cdef GLuint premultiplied
 
-        glGenTextures(1, &premultiplied)
-
         # Bind the framebuffer.
         draw.change_fbo(draw.fbo)
 
@@ -335,7 +600,7 @@ cdef class GLTexture(GL2Model):
         cdef Matrix transform
         transform = Matrix.ctexture_projection(cw, ch)
 
-        self.allocate_texture(premultiplied, tw, th, properties)
+        premultiplied = self.allocate_texture(tw, th, properties, pool=True)
 
         # Set up the viewport.
         glViewport(0, 0, tw, th)
@@ -346,16 +611,19 @@ cdef class GLTexture(GL2Model):
 
         # Set up the default modes.
         glEnable(GL_BLEND)
-        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+        renpy.gl2.gl2shader.reset_state()
 
         context = renpy.gl2.gl2draw.GL2DrawingContext(draw, tw, th)
         context.draw(what, transform)
 
         glBindTexture(GL_TEXTURE_2D, premultiplied)
-        glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, tw, th, 0)
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, tw, th)
 
         self.mipmap_texture(premultiplied, tw, th, properties)
 
+        # The texture binding was changed behind the shadow state's back.
+        renpy.gl2.gl2shader.reset_state()
+
         self.number = premultiplied
         self.loader.allocated.add(self.number)
 
@@ -376,43 +644,74 @@ cdef class GLTexture(GL2Model):
 
         cdef GLuint tex
         cdef GLuint premultiplied
-        cdef Program program
-        cdef SDL_Surface *s
 
         if self.loaded:
+            if self.dirty is not None:
+                self.update_dirty()
+
             return
 
-        draw = self.loader.draw
+        # Upload the rows of the surface that haven't been uploaded yet.
+        self.upload(-1)
+        tex = self.upload_number
 
-        s = PySurface_AsSurface(self.surface)
+        self.premultiply(tex, self.width, self.height)
 
-        # Generate the old textures.
-        glGenTextures(1, &tex)
-        glGenTextures(1, &premultiplied)
+        # Create premultiplied.
+        premultiplied = self.allocate_texture(self.width, self.height, self.properties)
 
-        # Bind the framebuffer.
-        draw.change_fbo(draw.fbo)
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, self.width, self.height)
 
-        # Load the pixel data into tex, and set it up for drawing.
-        glActiveTexture(GL_TEXTURE0)
-        glBindTexture(GL_TEXTURE_2D, tex)
+        self.mipmap_texture(premultiplied, self.width, self.height, self.properties)
 
-        # Setup the non-premultiplied texture.
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE)
+        # Delete tex.
+        glDeleteTextures(1, &tex)
+        self.loader.allocated.discard(tex)
 
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, s.pitch // 4)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, self.width, self.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, s.pixels)
+        self.upload_number = 0
+        self.uploaded_rows = 0
+
+        # The texture binding and blend mode were changed behind the shadow
+        # state's back.
+        renpy.gl2.gl2shader.reset_state()
+
+        # Store the loaded texture.
+        self.number = premultiplied
+        self.loader.allocated.add(self.number)
+
+        self.loaded = True
+        self.surface = None
+
+    def premultiply(GLTexture self, GLuint tex, int w, int h, int border=0):
+        """
+        Draws the `w` x `h` non-premultiplied texture `tex` into the
+        bottom-left of the framebuffer, premultiplying it. If `border` is
+        not zero, tex is drawn with a border that many pixels wide, which
+        repeats its edge pixels, as it's clamped.
+        """
+
+        cdef Program program
+        cdef float bu = 0.0
+        cdef float bv = 0.0
+
+        if border:
+            bu = 1.0 * border / w
+            bv = 1.0 * border / h
+
+        draw = self.loader.draw
+
+        # Bind the framebuffer.
+        draw.change_fbo(draw.fbo)
 
-        mesh = Mesh2.texture_rectangle(-1.0, -1.0, 1.0, 1.0, 0.0, 0.0, 1.0, 1.0)
+        mesh = Mesh2.texture_rectangle(-1.0, -1.0, 1.0, 1.0, -bu, -bv, 1.0 + bu, 1.0 + bv)
 
         # Set up the viewport.
-        glViewport(0, 0, self.width, self.height)
+        glViewport(0, 0, w + 2 * border, h + 2 * border)
 
-        # Set up the blend mode for premultiplication.
+        # Set up the blend mode for premultiplication. The default blend
+        # mode is set by reset_state, so drawing won't change this.
         glEnable(GL_BLEND)
+        renpy.gl2.gl2shader.reset_state()
         glBlendFuncSeparate(GL_SRC_ALPHA, GL_ZERO, GL_ONE, GL_ZERO)
 
         # Draw.
@@ -422,42 +721,150 @@ cdef class GLTexture(GL2Model):
         program.draw(mesh, {})
         program.finish()
 
-        # Create premultiplied.
-        self.allocate_texture(premultiplied, self.width, self.height, self.properties)
+    def update_dirty(GLTexture self):
+        """
+        Uploads the dirty rectangle of the surface into this texture, which
+        has already been loaded, and regenerates the mipmaps if the texture
+        has them.
+        """
 
-        glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, self.width, self.height, 0)
+        x0, y0, x1, y1 = self.dirty
 
-        self.mipmap_texture(premultiplied, self.width, self.height, self.properties)
+        self.copy_surface(self.surface, x0, y0, x1 - x0, y1 - y0, x0, y0, 0)
+        self.mipmap_texture(self.number, self.width, self.height, self.properties)
+
+        self.dirty = None
+        self.surface = None
+
+    def copy_surface(GLTexture self, surface, int sx, int sy, int w, int h, int dx, int dy, int border):
+        """
+        Uploads the `w` x `h` rectangle of `surface` at (`sx`, `sy`),
+        premultiplies it, and copies it into this texture, which has already
+        been loaded, at (`dx`, `dy`). If `border` is not zero, the edge
+        pixels of the rectangle are repeated that many times around it.
+        """
+
+        cdef GLuint tex
+        cdef SDL_Surface *s
+        cdef unsigned char *pixels
+
+        s = PySurface_AsSurface(surface)
+        pixels = (<unsigned char *> s.pixels) + sy * s.pitch + sx * 4
+
+        # Load the pixels into tex.
+        glGenTextures(1, &tex)
+
+        glActiveTexture(GL_TEXTURE0)
+        glBindTexture(GL_TEXTURE_2D, tex)
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE)
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, s.pitch // 4)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels)
+
+        self.premultiply(tex, w, h, border)
+
+        # Copy the premultiplied pixels into place.
+        glBindTexture(GL_TEXTURE_2D, self.number)
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, dx, dy, 0, 0, w + 2 * border, h + 2 * border)
 
-        # Delete tex.
         glDeleteTextures(1, &tex)
 
-        # Store the loaded texture.
-        self.number = premultiplied
-        self.loader.allocated.add(self.number)
+        # The texture binding and blend mode were changed behind the shadow
+        # state's back.
+        renpy.gl2.gl2shader.reset_state()
 
-        self.loaded = True
-        self.surface = None
+    def upload(GLTexture self, int rows):
+        """
+        Uploads up to `rows` rows of the surface to the non-premultiplied
+        texture, or all the remaining rows if `rows` is -1. Returns True once
+        every row has been uploaded.
+        """
+
+        cdef GLuint tex = self.upload_number
+        cdef SDL_Surface *s
+        cdef int start = self.uploaded_rows
+        cdef int end = self.height
+
+        if (rows >= 0) and (start + rows < end):
+            end = start + rows
+
+        s = PySurface_AsSurface(self.surface)
+
+        if not tex:
+            glGenTextures(1, &tex)
+            self.upload_number = tex
+            self.loader.allocated.add(tex)
+
+        # Load the pixel data into tex, and set it up for drawing.
+        glActiveTexture(GL_TEXTURE0)
+        glBindTexture(GL_TEXTURE_2D, tex)
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, s.pitch // 4)
+
+        if start == 0:
+
+            # Setup the non-premultiplied texture.
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE)
 
-    def allocate_texture(GLTexture self, GLuint tex, int tw, int th, properties={}):
+        if start == 0 and end == self.height:
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, self.width, self.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, s.pixels)
+
+        else:
+
+            if start == 0:
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, self.width, self.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL)
+
+            if end > start:
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, start, self.width, end - start, GL_RGBA, GL_UNSIGNED_BYTE, (<unsigned char *> s.pixels) + start * s.pitch)
+
+        self.uploaded_rows = end
+
+        # The texture binding was changed behind the shadow state's back.
+        renpy.gl2.gl2shader.reset_state()
+
+        return end == self.height
+
+    def allocate_texture(GLTexture self, int tw, int th, properties={}, pool=False):
         """
-        Allocates the VRAM required to store `tex`, which is a `tw` x `th`
-        texture, including all mipmap levels.
+        Allocates a texture, and the VRAM required to store it as a `tw` x
+        `th` texture, including all mipmap levels. Returns the number of the
+        texture, which is left bound.
+
+        If `pool` is true, the storage is taken from the texture pool if
+        possible, and is returned to the pool when this texture is freed.
         """
 
+        cdef GLuint tex = 0
+
         # It's not 100% clear why we need this function, but it does seem to
         # significantly speed things up on my GeForce GTX 1060 3GB/PCIe/SSE2.
         # Going from a single to multiple mipmap levels takes ~9ms when loading
         # each mipmap, while allocating the space first reduces that to ~1ms.
 
-        glBindTexture(GL_TEXTURE_2D, tex)
-
-
         max_level = renpy.config.max_mipmap_level
 
         if not properties.get("mipmap", True):
             max_level = 0
 
+        if pool:
+            self.pool_key = (tw, th, max_level)
+            tex = self.loader.get_pooled_texture(self.pool_key)
+
+        if tex:
+            reused = True
+        else:
+            reused = False
+            glGenTextures(1, &tex)
+
+        glBindTexture(GL_TEXTURE_2D, tex)
+
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level)
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR)
@@ -479,8 +886,10 @@ cdef class GLTexture(GL2Model):
         self.texture_width = tw
         self.texture_height = th
 
-        cdef GLuint level = 0
+        if reused:
+            return tex
 
+        cdef GLuint level = 0
 
         while True:
 
@@ -496,6 +905,8 @@ cdef class GLTexture(GL2Model):
             if level > max_level:
                 break
 
+        return tex
+
     def mipmap_texture(GLTexture self, GLuint tex, int tw, int th, properties={}):
         """
         Generate the mipmaps for a texture.
@@ -521,7 +932,10 @@ cdef class GLTexture(GL2Model):
     def __del__(self):
         try:
             if self.loaded:
-                self.loader.free_list.append(self.number)
+                self.loader.free_list.append((self.number, self.pool_key))
+
+            if self.upload_number:
+                self.loader.free_list.append((self.upload_number, None))
 
             self.loader.total_texture_size -= self.width * self.height * 4
         except TypeError:
@@ -545,3 +959,138 @@ class Texture(GLTexture):
     """
 
     pass
+
+
+class AtlasTexture(Texture):
+    """
+    A page of the texture atlas, which small surfaces are packed into using
+    shelves.
+    """
+
+    def __init__(self, size, loader, properties, gutter):
+        Texture.__init__(self, size, loader)
+
+        self.properties = properties
+
+        # The number of pixels around each image that repeat its edges.
+        self.gutter = gutter
+
+        self.mesh = Mesh2.texture_rectangle(
+            0.0, 0.0, self.width, self.height,
+            0.0, 0.0, 1.0, 1.0,
+            )
+
+        # A list of [ y, height, x ] lists, one for each shelf, where x is
+        # the first free column on the shelf.
+        self.shelves = [ ]
+
+        # The y coordinate of the top of the next shelf.
+        self.shelf_y = 0
+
+        # A list of (surface, x, y) tuples for the surfaces that have been
+        # packed into this page, but not uploaded.
+        self.pending = [ ]
+
+    def allocate(self, w, h):
+        """
+        Finds space for a `w` x `h` rectangle on this page, and returns its
+        (x, y) position, or None if there's no space.
+        """
+
+        best = None
+
+        for shelf in self.shelves:
+            if (shelf[1] >= h) and (shelf[2] + w <= self.width):
+                if (best is None) or (shelf[1] < best[1]):
+                    best = shelf
+
+        # Start a new shelf, rather than waste most of a tall one.
+        if (best is None) or (best[1] > 2 * h):
+            if (self.shelf_y + h <= self.height) and (w <= self.width):
+                best = [ self.shelf_y, h, 0 ]
+                self.shelves.append(best)
+                self.shelf_y += h
+
+        if best is None:
+            return None
+
+        x = best[2]
+        best[2] += w
+
+        return x, best[0]
+
+    def load_gltexture(self):
+        """
+        Allocates the page, and uploads the surfaces that have been packed
+        into it since it was last loaded.
+        """
+
+        if not self.loaded:
+            self.number = self.allocate_texture(self.width, self.height, self.properties)
+            self.loader.allocated.add(self.number)
+            self.loaded = True
+
+            self.clear()
+
+        if not self.pending:
+            return
+
+        for surf, x, y in self.pending:
+            w, h = surf.get_size()
+            self.copy_surface(surf, 0, 0, w, h, x, y, self.gutter)
+
+        self.pending = [ ]
+
+        self.mipmap_texture(self.number, self.width, self.height, self.properties)
+
+        if self.properties.get("mipmap", True):
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, min(renpy.config.max_mipmap_level, ATLAS_MIPMAP_LEVELS))
+
+            # The texture binding was changed behind the shadow state's back.
+            renpy.gl2.gl2shader.reset_state()
+
+    def clear(self):
+        """
+        Clears the page to transparent, so the mipmaps of the unused parts
+        of the page don't bleed into the images.
+        """
+
+        draw = self.loader.draw
+        draw.change_fbo(draw.fbo)
+
+        glViewport(0, 0, self.width, self.height)
+        glClearColor(0.0, 0.0, 0.0, 0.0)
+        glClear(GL_COLOR_BUFFER_BIT)
+
+        glBindTexture(GL_TEXTURE_2D, self.number)
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, self.width, self.height)
+
+        # The texture binding was changed behind the shadow state's back.
+        renpy.gl2.gl2shader.reset_state()
+
+
+class AtlasModel(GL2Model):
+    """
+    A model that draws a surface that's been packed into an atlas page. (This
+    is a Python class so the texture cache can keep a weak reference to it.)
+    """
+
+    def __init__(self, page, x, y, w, h):
+        GL2Model.__init__(self, (w, h), None, ("renpy.texture",), { "tex0" : page })
+
+        self.page = page
+
+        # The position of the surface, including its gutter, on the page.
+        self.atlas_x = x
+        self.atlas_y = y
+
+    def mutated(self, surface, rect):
+        """
+        Called when part of `surface` has changed. As the surface is small,
+        the whole of it is uploaded to the page again when it's next loaded.
+        """
+
+        entry = (surface, self.atlas_x, self.atlas_y)
+
+        if entry not in self.page.pending:
+            self.page.pending.append(entry)
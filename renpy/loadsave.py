@@ -33,13 +33,18 @@ import types
 import shutil
 import os
 import sys
+import time
+import hashlib
+import zlib
+import struct
+import pickletools
 
 import renpy
 
 import pickle
 import renpy.compat.pickle as cPickle
 
-from json import dumps as json_dumps
+from json import dumps as json_dumps, loads as json_loads
 
 # Dump that chooses which pickle to use:
 
@@ -58,6 +63,34 @@ def dumps(o):
         return pickle.dumps(o, pickle.HIGHEST_PROTOCOL)
 
 
+def dump_chunkable(roots, log, f):
+    """
+    Dumps (roots, log) to `f` as a protocol 2 pickle that split_chunks
+    can split. Returns the offset of the log in `f`.
+
+    This uses the pickle module, as cPickle on Python 2 only memoizes
+    objects with more than one reference, which makes the memo indices
+    change from save to save.
+    """
+
+    p = pickle.Pickler(f, 2)
+
+    # Dump the roots and log in turn with the same memo, leaving out each
+    # STOP, and then make them into a tuple.
+    p.dump(roots)
+    f.seek(-1, 1)
+
+    log_start = f.tell()
+
+    p.dump(log)
+    f.seek(-1, 1)
+
+    f.write(pickle.TUPLE2 + pickle.STOP)
+    f.truncate()
+
+    return log_start
+
+
 def loads(s):
     if renpy.config.use_cpickle:
         return cPickle.loads(s)
@@ -320,6 +353,267 @@ def safe_rename(old, new):
                 pass
 
 
+# Chunked saves.
+#
+# A chunked save is pickled with protocol 2, and split into chunks at
+# places that depend on the content of the pickle. For the same data to
+# give the same chunk in the next save, the memo opcodes are rewritten so
+# that they don't contain the memo indices, which shift whenever an object
+# is added to or removed from the pickle:
+#
+# * BINPUT has no argument, and puts the next index. LONG_BINPUT is used
+#   with a 4-byte absolute index when the put skips an index.
+# * LONG_BINGET takes a 4-byte absolute index, and is used for objects
+#   in the roots.
+# * GET takes a 4-byte index relative to the first object in the log.
+# * BINGET takes a 4-byte index relative to the next index.
+#
+# join_chunks turns this back into the pickle the pickler wrote.
+
+BINPUT = ord(pickle.BINPUT)
+LONG_BINPUT = ord(pickle.LONG_BINPUT)
+BINGET = ord(pickle.BINGET)
+GET = ord(pickle.GET)
+PUT = ord(pickle.PUT)
+LONG_BINGET = ord(pickle.LONG_BINGET)
+
+TAKEN_FROM_ARGUMENT4U = getattr(pickletools, "TAKEN_FROM_ARGUMENT4U", None)
+
+# The argument of GLOBAL and INST is two lines.
+UP_TO_SECOND_NEWLINE = -100
+
+
+def chunk_opcode_lengths(chunked):
+    """
+    Returns a list mapping each protocol 2 pickle opcode to the length of its
+    argument, or a negative number from pickletools if it's variable. If
+    `chunked` is true, this is for the format written by split_chunks.
+    """
+
+    rv = [ None ] * 256
+
+    for op in pickletools.opcodes:
+        if op.proto > 2:
+            continue
+
+        code = ord(op.code)
+
+        if op.arg is None:
+            rv[code] = 0
+        elif op.arg.name == "stringnl_noescape_pair":
+            rv[code] = UP_TO_SECOND_NEWLINE
+        else:
+            rv[code] = op.arg.n
+
+    if chunked:
+        rv[BINPUT] = 0
+        rv[LONG_BINPUT] = 4
+        rv[BINGET] = 4
+        rv[LONG_BINGET] = 4
+        rv[GET] = 4
+        rv[PUT] = None
+    else:
+        rv[GET] = None
+        rv[PUT] = None
+
+    return rv
+
+
+pickle_opcode_lengths = chunk_opcode_lengths(False)
+chunked_opcode_lengths = chunk_opcode_lengths(True)
+
+chunk_gear = [ zlib.crc32(struct.pack("<I", i)) & 0xffffffff for i in range(256) ]
+
+
+def opcode_end(b, pos, n):
+    """
+    Returns the end of an opcode with an argument of length `n` at `pos`.
+    """
+
+    if n >= 0:
+        return pos + n
+    elif n == pickletools.UP_TO_NEWLINE:
+        return b.index(b"\n", pos) + 1
+    elif n == UP_TO_SECOND_NEWLINE:
+        return b.index(b"\n", b.index(b"\n", pos) + 1) + 1
+    elif n == pickletools.TAKEN_FROM_ARGUMENT1:
+        return pos + 1 + b[pos]
+    elif n == pickletools.TAKEN_FROM_ARGUMENT4:
+        return pos + 4 + struct.unpack_from("<i", b, pos)[0]
+    elif n == TAKEN_FROM_ARGUMENT4U:
+        return pos + 4 + struct.unpack_from("<I", b, pos)[0]
+
+    raise ValueError("Unknown pickle argument.")
+
+
+def split_chunks(data, size, log_start):
+    """
+    Splits the protocol 2 pickle `data` into chunks of about `size` bytes,
+    where the log starts at `log_start`. Returns a list of chunks, and the
+    memo index of the first object in the log.
+
+    Raises ValueError if the pickle can't be split.
+    """
+
+    b = bytearray(data)
+    end = len(b)
+
+    pos = 0
+    copied = 0
+
+    next_index = 0
+    roots_index = None
+
+    h = 0
+
+    bits = max(size // 16, 1).bit_length()
+    mask = ((1 << bits) - 1) << (32 - bits)
+
+    min_size = size // 4
+    max_size = size * 4
+
+    chunk = bytearray()
+    rv = [ ]
+
+    while pos < end:
+
+        if (roots_index is None) and (pos >= log_start):
+            roots_index = next_index
+
+        op = b[pos]
+        n = pickle_opcode_lengths[op]
+
+        if n is None:
+            raise ValueError("Unknown pickle opcode.")
+
+        start = pos
+        pos = opcode_end(b, pos + 1, n)
+
+        if op == BINPUT or op == LONG_BINPUT or op == BINGET or op == LONG_BINGET:
+
+            if op == BINPUT or op == BINGET:
+                index = b[start + 1]
+            else:
+                index = struct.unpack_from("<I", b, start + 1)[0]
+
+            # join_chunks picks the opcode from the index, as the pickler does.
+            if (index < 256) != (op == BINPUT or op == BINGET):
+                raise ValueError("Unexpected memo opcode.")
+
+            chunk += b[copied:start]
+            copied = pos
+
+            marker = len(chunk)
+
+            if op == BINPUT or op == LONG_BINPUT:
+                if index == next_index:
+                    chunk.append(BINPUT)
+                else:
+                    chunk.append(LONG_BINPUT)
+                    chunk += struct.pack("<I", index)
+
+                next_index = index + 1
+
+            elif (roots_index is None) or (index < roots_index):
+                chunk.append(LONG_BINGET)
+                chunk += struct.pack("<I", index)
+
+            elif index - roots_index < next_index - index:
+                chunk.append(GET)
+                chunk += struct.pack("<I", index - roots_index)
+
+            else:
+                chunk.append(BINGET)
+                chunk += struct.pack("<I", next_index - index)
+
+            # The boundaries depend on the chunked form of the opcode,
+            # which doesn't change when the memo indices do.
+            op = chunk[marker]
+            last = chunk[-1] if len(chunk) == marker + 1 else chunk[marker + 1]
+
+        else:
+            last = b[pos - 1]
+
+        h = ((h << 1) + chunk_gear[op ^ last]) & 0xffffffff
+
+        length = len(chunk) + pos - copied
+
+        if (length >= max_size) or ((length >= min_size) and not (h & mask)):
+            chunk += b[copied:pos]
+            copied = pos
+
+            rv.append(bytes(chunk))
+            chunk = bytearray()
+
+    chunk += b[copied:end]
+
+    if chunk:
+        rv.append(bytes(chunk))
+
+    return rv, roots_index
+
+
+def join_chunks(chunks, roots_index):
+    """
+    Joins the `chunks` returned by split_chunks back into a pickle.
+    """
+
+    b = bytearray(b"".join(chunks))
+    end = len(b)
+
+    pos = 0
+    copied = 0
+    next_index = 0
+
+    rv = bytearray()
+
+    while pos < end:
+        op = b[pos]
+        n = chunked_opcode_lengths[op]
+
+        if n is None:
+            raise ValueError("Unknown pickle opcode.")
+
+        start = pos
+        pos = opcode_end(b, pos + 1, n)
+
+        if op == BINPUT or op == LONG_BINPUT or op == BINGET or op == LONG_BINGET or op == GET:
+            rv += b[copied:start]
+            copied = pos
+
+            if op == BINPUT:
+                index = next_index
+            else:
+                index = struct.unpack_from("<I", b, start + 1)[0]
+
+            if op == BINGET:
+                index = next_index - index
+            elif op == GET:
+                index += roots_index
+
+            if op == BINPUT or op == LONG_BINPUT:
+                next_index = index + 1
+
+                if index < 256:
+                    rv.append(BINPUT)
+                    rv.append(index)
+                else:
+                    rv.append(LONG_BINPUT)
+                    rv += struct.pack("<I", index)
+
+            else:
+                if index < 256:
+                    rv.append(BINGET)
+                    rv.append(index)
+                else:
+                    rv.append(LONG_BINGET)
+                    rv += struct.pack("<I", index)
+
+    rv += b[copied:end]
+
+    return bytes(rv)
+
+
 class SaveRecord(object):
     """
     This is passed to the save locations. It contains the information that
@@ -327,19 +621,42 @@ class SaveRecord(object):
     information to a Ren'Py-standard format save file.
     """
 
-    def __init__(self, screenshot, extra_info, json, log):
+    def __init__(self, screenshot, extra_info, json, log, log_start=None):
         self.screenshot = screenshot
         self.extra_info = extra_info
         self.json = json
         self.log = log
 
+        # The offset of the rollback log in log, if log was written by
+        # dump_chunkable.
+        self.log_start = log_start
+
+        # The time the save was made.
+        self.mtime = time.time()
+
         self.first_filename = None
 
-    def write_file(self, filename):
+        # A list of (digest, chunk) tuples, if the log has been split into
+        # chunks, and the roots_index returned by split_chunks.
+        self.chunks = None
+        self.roots_index = None
+
+        # The number of bytes written to the chunk directory by the last
+        # write_chunked_file, and the size of all the chunks the save uses.
+        self.bytes_written = 0
+        self.bytes_total = 0
+
+    def write_file(self, filename, chunk_directory=None):
         """
-        This writes a standard-format savefile to `filename`.
+        This writes a standard-format savefile to `filename`. If
+        `chunk_directory` is given and config.save_chunk_size is set, the
+        log is written to the chunk store in that directory.
         """
 
+        if (chunk_directory is not None) and (self.log_start is not None):
+            if self.write_chunked_file(filename, chunk_directory):
+                return
+
         filename_new = filename + ".new"
 
         # For speed, copy the file after we've written it at least once.
@@ -369,6 +686,76 @@ class SaveRecord(object):
 
         self.first_filename = filename
 
+    def write_chunked_file(self, filename, chunk_directory):
+        """
+        Writes a savefile to `filename`, where the log is split into chunks
+        named after their contents. The chunks are stored in
+        `chunk_directory`, where they're shared with the other saves, so
+        only chunks that aren't there already have to be written.
+
+        Returns False if the log can't be split, in which case nothing is
+        written.
+        """
+
+        if self.chunks is None:
+            try:
+                chunks, self.roots_index = split_chunks(self.log, renpy.config.save_chunk_size, self.log_start)
+            except ValueError:
+                renpy.display.log.write("Could not split the log of %s into chunks.", filename)
+                self.log_start = None
+                return False
+
+            self.chunks = [ (hashlib.sha1(i).hexdigest(), i) for i in chunks ]
+
+        try:
+            os.makedirs(chunk_directory)
+        except:
+            pass
+
+        self.bytes_written = 0
+        self.bytes_total = 0
+
+        for digest, data in self.chunks:
+            fn = os.path.join(chunk_directory, digest)
+
+            if os.path.exists(fn):
+                self.bytes_total += os.path.getsize(fn)
+                continue
+
+            data = zlib.compress(data)
+
+            with open(fn + ".new", "wb") as f:
+                f.write(data)
+
+            safe_rename(fn + ".new", fn)
+
+            self.bytes_written += len(data)
+            self.bytes_total += len(data)
+
+        filename_new = filename + ".new"
+
+        with zipfile.ZipFile(filename_new, "w", zipfile.ZIP_DEFLATED) as zf:
+            if self.screenshot is not None:
+                zf.writestr("screenshot.png", self.screenshot)
+
+            zf.writestr("extra_info", self.extra_info.encode("utf-8"))
+            zf.writestr("json", self.json)
+            zf.writestr("renpy_version", renpy.version)
+
+            # The digests of the chunks that make up the log, in order.
+            zf.writestr("chunks", "\n".join(i[0] for i in self.chunks).encode("utf-8"))
+            zf.writestr("chunks_roots", str(self.roots_index).encode("utf-8"))
+
+        self.bytes_written += os.path.getsize(filename_new)
+        self.bytes_total += os.path.getsize(filename_new)
+
+        safe_rename(filename_new, filename)
+
+        if renpy.config.profile:
+            renpy.display.log.write("Saved %s: wrote %d bytes, of %d bytes in %d chunks.", filename, self.bytes_written, self.bytes_total, len(self.chunks))
+
+        return True
+
 
 def save(slotname, extra_info='', mutate_flag=False):
     """
@@ -388,6 +775,8 @@ def save(slotname, extra_info='', mutate_flag=False):
     :func:`renpy.take_screenshot` should be called before this function.
     """
 
+    start = time.time()
+
     if mutate_flag:
         renpy.python.mutate_flag = False
 
@@ -397,8 +786,13 @@ def save(slotname, extra_info='', mutate_flag=False):
         save_dump(roots, renpy.game.log)
 
     logf = io.BytesIO()
+    log_start = None
+
     try:
-        dump((roots, renpy.game.log), logf)
+        if renpy.config.save_chunk_size:
+            log_start = dump_chunkable(roots, renpy.game.log, logf)
+        else:
+            dump((roots, renpy.game.log), logf)
     except:
 
         t, e, tb = sys.exc_info()
@@ -431,13 +825,100 @@ def save(slotname, extra_info='', mutate_flag=False):
 
     json = json_dumps(json)
 
-    sr = SaveRecord(screenshot, extra_info, json, logf.getvalue())
+    sr = SaveRecord(screenshot, extra_info, json, logf.getvalue(), log_start)
+
+    # The autosave thread is already in the background, and emscripten
+    # doesn't have threads.
+    if renpy.config.save_in_background and (not mutate_flag) and (not renpy.emscripten):
+        start_save_thread(slotname, sr, start)
+        return
+
     location.save(slotname, sr)
 
     location.scan()
     clear_slot(slotname)
 
 
+# A map from the name of a slot to the SaveRecord the save thread is writing
+# to it. Until it's written, the slot's information comes from the record.
+pending_saves = { }
+
+# The thread writing a save in the background, or None.
+save_thread = None
+
+# A list of (slotname, sys.exc_info()) tuples for background saves that
+# failed, which check_saves raises on the main thread.
+failed_saves = [ ]
+
+
+def save_thread_function(slotname, sr, start):
+
+    try:
+        location.save(slotname, sr)
+        location.scan()
+
+        if renpy.config.profile:
+            renpy.display.log.write("Saving %r took %.1f ms, %.1f ms on the main thread.", slotname, (time.time() - start) * 1000, (sr.mtime - start) * 1000)
+
+    except:
+        renpy.display.log.write("While saving %r in the background:", slotname)
+        renpy.display.log.exception()
+
+        failed_saves.append((slotname, sys.exc_info()))
+
+    finally:
+        if pending_saves.get(slotname, None) is sr:
+            del pending_saves[slotname]
+
+        clear_slot(slotname)
+
+
+def start_save_thread(slotname, sr, start):
+    """
+    Starts the save thread, which compresses `sr` and writes it to
+    `slotname`. The pickling is done by then, so the save reflects the
+    state of the game when save() was called.
+    """
+
+    global save_thread
+
+    wait_for_saves()
+
+    pending_saves[slotname] = sr
+    clear_slot(slotname)
+
+    save_thread = threading.Thread(target=save_thread_function, args=(slotname, sr, start))
+    save_thread.start()
+
+
+def wait_for_saves():
+    """
+    Blocks until the save thread has finished writing.
+    """
+
+    global save_thread
+
+    t = save_thread
+
+    if t is not None:
+        t.join()
+        save_thread = None
+
+
+def check_saves():
+    """
+    Called by the interaction loop. If a background save has failed, raises
+    its exception once, as save() would have if the save had been written
+    on the main thread.
+    """
+
+    if not failed_saves:
+        return
+
+    _slotname, (t, e, tb) = failed_saves.pop(0)
+    reraise(t, e, tb)
+
+
 # The thread used for autosave.
 autosave_thread = None
 
@@ -600,6 +1081,18 @@ def scan_saved_game(slotname):
     return extra_info, screenshot, mtime
 
 
+def list_slot_names():
+    """
+    Returns the names of the slots with saves in them, including the slots
+    the save thread is writing to.
+    """
+
+    rv = set(location.list())
+    rv.update(pending_saves)
+
+    return list(rv)
+
+
 def list_saved_games(regexp=r'.', fast=False):
     """
     :doc: loadsave
@@ -622,7 +1115,7 @@ def list_saved_games(regexp=r'.', fast=False):
     """
 
     # A list of save slots.
-    slots = location.list()
+    slots = list_slot_names()
 
     if regexp is not None:
         slots = [ i for i in slots if re.match(regexp, i) ]
@@ -663,7 +1156,7 @@ def list_slots(regexp=None):
     """
 
     # A list of save slots.
-    slots = location.list()
+    slots = list_slot_names()
 
     if regexp is not None:
         slots = [ i for i in slots if re.match(regexp, i) ]
@@ -693,7 +1186,7 @@ def newest_slot(regexp=None):
         max_mtime = 0
         rv = None
 
-        slots = location.list()
+        slots = list_slot_names()
 
         for i in slots:
 
@@ -767,6 +1260,8 @@ def load(filename):
     successfully, this function never returns.
     """
 
+    wait_for_saves()
+
     roots, log = loads(location.load(filename))
     log.unfreeze(roots, label="_after_load")
 
@@ -778,6 +1273,8 @@ def unlink_save(filename):
     Deletes the save slot with the given name.
     """
 
+    wait_for_saves()
+
     location.unlink(filename)
     clear_slot(filename)
 
@@ -790,6 +1287,8 @@ def rename_save(old, new):
     exist.)
     """
 
+    wait_for_saves()
+
     location.rename(old, new)
 
     clear_slot(old)
@@ -804,6 +1303,8 @@ def copy_save(old, new):
     exist.)
     """
 
+    wait_for_saves()
+
     location.copy(old, new)
     clear_slot(new)
 
@@ -841,6 +1342,21 @@ class Cache(object):
         self.clear()
 
     def clear(self):
+
+        # While the save thread is writing a save, use its record.
+        record = pending_saves.get(self.slotname, None)
+
+        if record is not None:
+            self.mtime = record.mtime
+            self.json = json_loads(record.json)
+
+            if record.screenshot is not None:
+                self.screenshot = renpy.display.im.Data(record.screenshot, "screenshot.png")
+            else:
+                self.screenshot = None
+
+            return
+
         # The time the save was created.
         self.mtime = unknown
 
@@ -329,6 +329,119 @@ def android_searchpath():
     print("Android search paths:" , " ".join(renpy.config.searchpath))
 
 
+def parse_test():
+    """
+    Times the parser on a large synthetic script, to benchmark the lexer.
+    """
+
+    block = """\
+label bench_{0}:
+
+    scene bg room
+    show eileen happy at left with dissolve
+
+    e "This is line {0} of the benchmark, with {{b}}text tags{{/b}} and [name]."
+    e happy "Say statements can have \\"escaped\\" quotes, and 'other' quotes."
+    "Narration goes here, and it can be fairly long, to give the lexer some text to skip."
+
+    $ points = points + {0} * 2 - (bonus["level"] if bonus else 0)
+    $ store.flags.update({{ "seen_{0}" : True, "count" : len(flags) }})
+
+    if points >= {0} and not (flags.get("skip") or persistent.fast):
+        jump bench_{0}_end
+
+    menu:
+        "Go left." if points > 10:
+            $ direction = "left"
+        "Go right.":
+            call screen choose(items=[ "a", "b", 'c' ], default=None) nopredict
+
+    python:
+        result = some_function(1, 2.5, key=u"value", *args, **kwargs)
+
+label bench_{0}_end:
+    play music "music/theme_{0}.ogg" fadein 1.0
+    e "We've reached the end of block {0}."
+    return
+
+"""
+
+    filedata = "".join(block.format(i) for i in range(2000))
+
+    times = [ ]
+
+    for _i in range(5):
+        start = time.time()
+        renpy.parser.parse("parse_test.rpy", filedata)
+        times.append(time.time() - start)
+
+    del renpy.parser.parse_errors[:]
+
+    print("Parsed {} lines: best {:.3f}s, mean {:.3f}s.".format(
+        filedata.count("\n"),
+        min(times),
+        sum(times) / len(times)))
+
+
+def rollback_test():
+    """
+    Times checkpointing stores of several sizes, with the write barrier and
+    with config.diff_whole_store, and the cost the write barrier adds to
+    code that assigns to store variables.
+    """
+
+    def best(f):
+        times = [ ]
+
+        for _i in range(5):
+            start = time.time()
+            f()
+            times.append(time.time() - start)
+
+        return min(times)
+
+    diff_whole_store = renpy.config.diff_whole_store
+
+    try:
+
+        for size in (1000, 10000, 30000):
+
+            sd = renpy.python.StoreDict()
+
+            for i in range(size):
+                dict.__setitem__(sd, "var_{}".format(i), i)
+
+            def checkpoint():
+                for i in range(10):
+                    sd.begin()
+                    sd["var_{}".format(i)] = -i
+                    sd.get_changes(False)
+
+            renpy.config.diff_whole_store = False
+            barrier = best(checkpoint)
+
+            renpy.config.diff_whole_store = True
+            whole = best(checkpoint)
+
+            print("Checkpoint, {} variables: write barrier {:.3f}ms, whole store {:.3f}ms.".format(
+                size,
+                barrier * 100,
+                whole * 100))
+
+    finally:
+        renpy.config.diff_whole_store = diff_whole_store
+
+    code = compile("for i in range(1000000):\n    x = i\n", "rollback_test.py", "exec")
+
+    def run_in(d):
+        exec(code, d)
+
+    plain = best(lambda : run_in({ }))
+    barrier = best(lambda : run_in(renpy.python.StoreDict()))
+
+    print("1,000,000 store writes: dict {:.3f}s, StoreDict {:.3f}s.".format(plain, barrier))
+
+
 def main():
 
     gc.set_threshold(*renpy.config.gc_thresholds)
@@ -493,6 +606,14 @@ def main():
         print(time.time() - start)
         sys.exit(0)
 
+    if renpy.game.args.command == 'parse-test': # @UndefinedVariable
+        parse_test()
+        sys.exit(0)
+
+    if renpy.game.args.command == 'rollback-test': # @UndefinedVariable
+        rollback_test()
+        sys.exit(0)
+
     renpy.game.exception_info = 'After loading the script.'
 
     # Find the save directory.
@@ -506,8 +627,10 @@ def main():
     game.persistent = renpy.persistent.init()
     game.preferences = game.persistent._preferences
 
+    translator = renpy.game.script.translator
+
     for i in renpy.game.persistent._seen_translates: # @UndefinedVariable
-        if i in renpy.game.script.translator.default_translates:
+        if (i in translator.default_translates) or (i in translator.lazy_translates):
             renpy.game.seen_translates_count += 1
 
     if game.persistent._virtual_size:
@@ -671,6 +794,7 @@ def main():
 
                 # Give Ren'Py a couple of seconds to finish saving.
                 renpy.loadsave.autosave_not_running.wait(3.0)
+                renpy.loadsave.wait_for_saves()
 
     finally:
 
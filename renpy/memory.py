@@ -493,6 +493,12 @@ def profile_rollback():
 
     write("")
     write("{} Rollback objects exist.".format(len(log)))
+    renpy.game.log.measure_size()
+    write("The rollback log stores about {:,d} bytes of changes.".format(renpy.game.log.get_size()))
+
+    if renpy.config.rollback_memory_limit is not None:
+        write("The rollback memory limit is {:,d} bytes.".format(renpy.config.rollback_memory_limit))
+
     write("")
 
 
@@ -41,6 +41,7 @@ import renpy.sl2
 parse_errors = [ ]
 
 from renpy.parsersupport import match_logical_word
+import renpy.parsersupport as parsersupport
 
 
 def get_line_text(filename, lineno):
@@ -571,9 +572,15 @@ ESCAPED_OPERATORS = [
 
 operator_regexp = "|".join([ re.escape(i) for i in OPERATORS ] + ESCAPED_OPERATORS)
 
+parsersupport.init_lexer(KEYWORDS, OPERATORS, [ i[2:-2] for i in ESCAPED_OPERATORS ])
+
 word_regexp = r'[a-zA-Z_\u00a0-\ufffd][0-9a-zA-Z_\u00a0-\ufffd]*'
 image_word_regexp = r'[-0-9a-zA-Z_\u00a0-\ufffd][-0-9a-zA-Z_\u00a0-\ufffd]*'
 
+# A map from a regexp to the compiled form of that regexp, used by
+# Lexer.match_regexp.
+regexp_cache = { }
+
 
 class SubParse(object):
     """
@@ -678,7 +685,12 @@ class Lexer(object):
         if self.pos == len(self.text):
             return None
 
-        m = re.compile(regexp, re.DOTALL).match(self.text, self.pos)
+        compiled = regexp_cache.get(regexp, None)
+
+        if compiled is None:
+            compiled = regexp_cache[regexp] = re.compile(regexp, re.DOTALL)
+
+        m = compiled.match(self.text, self.pos)
 
         if not m:
             return None
@@ -687,14 +699,37 @@ class Lexer(object):
 
         return m.group(0)
 
+    def match_function(self, function):
+        """
+        Like match, but instead of a regexp, takes one of the functions in
+        renpy.parsersupport that return the end of what they match at a
+        position, or -1 if there's no match.
+        """
+
+        self.skip_whitespace()
+
+        if self.eob:
+            return None
+
+        end = function(self.text, self.pos)
+
+        if end < 0:
+            return None
+
+        rv = self.text[self.pos:end]
+        self.pos = end
+
+        return rv
+
     def skip_whitespace(self):
         """
         Advances the current position beyond any contiguous whitespace.
         """
 
-        # print self.text[self.pos].encode('unicode_escape')
+        if self.eob:
+            return
 
-        self.match_regexp(r"(\s+|\\\n)+")
+        self.pos = parsersupport.whitespace(self.text, self.pos)
 
     def match(self, regexp):
         """
@@ -740,6 +775,15 @@ class Lexer(object):
 
         raise ParseError(self.filename, self.number, msg, self.text, self.pos)
 
+    def lex_error(self, e):
+        """
+        Reports a renpy.parsersupport.LexError as a parse error at the
+        position it occurred.
+        """
+
+        self.pos = e.pos
+        self.error(e.message)
+
     def eol(self):
         """
         Returns True if, after skipping whitespace, the current
@@ -804,13 +848,7 @@ class Lexer(object):
         different than None.
         """
 
-        s = self.match(r'r?"([^\\"]|\\.)*"')
-
-        if s is None:
-            s = self.match(r"r?'([^\\']|\\.)*'")
-
-        if s is None:
-            s = self.match(r"r?`([^\\`]|\\.)*`")
+        s = self.match_function(parsersupport.string)
 
         if s is None:
             return None
@@ -859,13 +897,7 @@ class Lexer(object):
         newline.
         """
 
-        s = self.match(r'r?"""([^\\"]|\\.)*"""')
-
-        if s is None:
-            s = self.match(r"r?'''([^\\']|\\.)*'''")
-
-        if s is None:
-            s = self.match(r"r?```([^\\`]|\\.)*```")
+        s = self.match_function(parsersupport.triple_string)
 
         if s is None:
             return None
@@ -953,7 +985,7 @@ class Lexer(object):
             return self.word_cache
 
         self.word_cache_pos = self.pos
-        rv = self.match(word_regexp)
+        rv = self.match_function(parsersupport.word)
         self.word_cache = rv
         self.word_cache_newpos = self.pos
 
@@ -1040,7 +1072,7 @@ class Lexer(object):
         """
 
         oldpos = self.pos
-        rv = self.match(image_word_regexp)
+        rv = self.match_function(parsersupport.image_word)
 
         if (rv == "r") or (rv == "u"):
             if self.text[self.pos:self.pos + 1] in ('"', "'", "`"):
@@ -1064,43 +1096,15 @@ class Lexer(object):
         if self.eol():
             return False
 
-        old_pos = self.pos
-        c = self.text[self.pos]
-
-        # Allow unicode and raw strings.
-        for mod in ('u', 'r'):
-            if c != mod:
-                continue
-
-            self.pos += 1
-
-            if self.pos == len(self.text):
-                self.pos = old_pos
-                return False
-
-            c = self.text[self.pos]
+        try:
+            end = parsersupport.python_string(self.text, self.pos)
+        except parsersupport.LexError as e:
+            self.lex_error(e)
 
-        if c not in ('"', "'"):
-            self.pos = old_pos
+        if end < 0:
             return False
 
-        delim = c
-
-        while True:
-            self.pos += 1
-
-            if self.eol():
-                self.error("end of line reached while parsing string.")
-
-            c = self.text[self.pos]
-
-            if c == delim:
-                break
-
-            if c == '\\':
-                self.pos += 1
-
-        self.pos += 1
+        self.pos = end
         return True
 
     def dotted_name(self):
@@ -1144,23 +1148,12 @@ class Lexer(object):
 
         start = self.pos
 
-        while not self.eol():
-
-            c = self.text[self.pos]
-
-            if c in delim:
-                return self.expr(self.text[start:self.pos], expr)
-
-            if c in "'\"":
-                self.python_string()
-                continue
-
-            if self.parenthesised_python():
-                continue
-
-            self.pos += 1
+        try:
+            self.pos = parsersupport.delimited_python(self.text, self.pos, delim)
+        except parsersupport.LexError as e:
+            self.lex_error(e)
 
-        self.error("reached end of line when expecting '%s'." % delim)
+        return self.expr(self.text[start:self.pos], expr)
 
     def python_expression(self, expr=True):
         """
@@ -1184,27 +1177,16 @@ class Lexer(object):
         closing parenthesis. Returns False otherwise.
         """
 
-        c = self.text[self.pos]
-
-        if c == '(':
-            self.pos += 1
-            self.delimited_python(')', False)
-            self.pos += 1
-            return True
-
-        if c == '[':
-            self.pos += 1
-            self.delimited_python(']', False)
-            self.pos += 1
-            return True
+        try:
+            end = parsersupport.parenthesised_python(self.text, self.pos)
+        except parsersupport.LexError as e:
+            self.lex_error(e)
 
-        if c == '{':
-            self.pos += 1
-            self.delimited_python('}', False)
-            self.pos += 1
-            return True
+        if end < 0:
+            return False
 
-        return False
+        self.pos = end
+        return True
 
     def simple_expression(self, comma=False, operator=True):
         """
@@ -1214,51 +1196,10 @@ class Lexer(object):
 
         start = self.pos
 
-        # Operator.
-        while True:
-
-            while self.match(operator_regexp):
-                pass
-
-            if self.eol():
-                break
-
-            # We start with either a name, a python_string, or parenthesized
-            # python
-            if not (self.python_string() or
-                    self.name() or
-                    self.float() or
-                    self.parenthesised_python()):
-
-                break
-
-            while True:
-                self.skip_whitespace()
-
-                if self.eol():
-                    break
-
-                # If we see a dot, expect a dotted name.
-                if self.match(r'\.'):
-                    n = self.word()
-                    if not n:
-                        self.error("expecting name after dot.")
-
-                    continue
-
-                # Otherwise, try matching parenthesised python.
-                if self.parenthesised_python():
-                    continue
-
-                break
-
-            if operator and self.match(operator_regexp):
-                continue
-
-            if comma and self.match(r','):
-                continue
-
-            break
+        try:
+            self.pos = parsersupport.simple_expression(self.text, self.pos, comma, operator)
+        except parsersupport.LexError as e:
+            self.lex_error(e)
 
         text = self.text[start:self.pos].strip()
 
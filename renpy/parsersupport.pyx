@@ -21,6 +21,14 @@
 
 from __future__ import print_function
 
+import sys
+
+from cpython.unicode cimport Py_UNICODE_ISSPACE, Py_UNICODE_ISALNUM, Py_UNICODE_ISDECIMAL
+
+# Python 2 compiles the lexer's regexes without re.UNICODE, so \s, \w and \d
+# only match ASCII there.
+cdef bint PY2 = sys.version_info[0] == 2
+
 cdef inline int letterlike(Py_UNICODE c):
     if u'a' <= c <= u'z':
         return 1
@@ -79,8 +87,576 @@ def match_logical_word(unicode s, int pos):
     return s[start:pos], magic, pos
 
 
+################################################################################
+# Lexer primitives.
+#
+# These each take the text of a logical line and a position in it, and return
+# the position after what they match. They're used by renpy.parser.Lexer,
+# and match the same text as the regexes they replace.
+
+class LexError(Exception):
+    """
+    Raised when the end of the line is reached while lexing a string or
+    delimited Python. `pos` is the position of the error.
+    """
+
+    def __init__(self, message, pos):
+        Exception.__init__(self, message)
+
+        self.message = message
+        self.pos = pos
+
+# The keywords that aren't names, the operators, and the operators that are
+# words, as set by renpy.parser.
+cdef object keywords = frozenset()
+cdef tuple operators = ()
+cdef tuple word_operators = ()
+
+def init_lexer(kw, ops, word_ops):
+    """
+    Sets the keywords and operators used by simple_expression.
+    """
+
+    global keywords, operators, word_operators
+
+    keywords = kw
+    operators = tuple(ops)
+    word_operators = tuple(word_ops)
+
+
+cdef inline bint is_space(Py_UCS4 c):
+    """
+    Matches \s.
+    """
+
+    if PY2:
+        return c == u' ' or (u'\t' <= c <= u'\r')
+
+    return Py_UNICODE_ISSPACE(c)
+
+
+cdef inline bint is_word(Py_UCS4 c):
+    """
+    Matches \w.
+    """
+
+    if letterlike(c):
+        return True
+
+    if PY2 or c < 128:
+        return False
+
+    return Py_UNICODE_ISALNUM(c)
+
+
+cdef inline bint is_digit(Py_UCS4 c):
+    """
+    Matches \d.
+    """
+
+    if u'0' <= c <= u'9':
+        return True
+
+    if PY2 or c < 128:
+        return False
+
+    return Py_UNICODE_ISDECIMAL(c)
+
+
+cdef inline bint word_start(Py_UCS4 c):
+    """
+    Matches the first character of renpy.parser.word_regexp.
+    """
+
+    if u'a' <= c <= u'z':
+        return True
+
+    if u'A' <= c <= u'Z':
+        return True
+
+    if c == u'_':
+        return True
+
+    return 0xa0 <= c <= 0xfffd
+
+
+cdef inline bint word_char(Py_UCS4 c):
+    """
+    Matches the rest of renpy.parser.word_regexp.
+    """
+
+    return word_start(c) or (u'0' <= c <= u'9')
+
+
+cdef inline bint image_word_char(Py_UCS4 c):
+    """
+    Matches renpy.parser.image_word_regexp.
+    """
+
+    return word_char(c) or (c == u'-')
+
+
+cdef Py_ssize_t skip_whitespace(unicode text, Py_ssize_t pos):
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_UCS4 c
+
+    while pos < len_text:
+        c = text[pos]
+
+        if is_space(c):
+            pos += 1
+            continue
+
+        if c == u'\\' and pos + 1 < len_text and text[pos + 1] == u'\n':
+            pos += 2
+            continue
+
+        break
+
+    return pos
+
+
+def whitespace(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after any whitespace and escaped newlines at `pos`.
+    """
+
+    return skip_whitespace(text, pos)
+
+
+cdef Py_ssize_t match_word(unicode text, Py_ssize_t pos):
+
+    cdef Py_ssize_t len_text = len(text)
+
+    if pos >= len_text or not word_start(text[pos]):
+        return pos
+
+    pos += 1
+
+    while pos < len_text and word_char(text[pos]):
+        pos += 1
+
+    return pos
+
+
+def word(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after the word at `pos`, or -1 if there isn't one.
+    """
+
+    cdef Py_ssize_t end = match_word(text, pos)
+
+    if end == pos:
+        return -1
+
+    return end
+
+
+def image_word(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after the image name component at `pos`, or -1 if
+    there isn't one.
+    """
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_ssize_t end = pos
+
+    while end < len_text and image_word_char(text[end]):
+        end += 1
+
+    if end == pos:
+        return -1
+
+    return end
+
+
+cdef Py_ssize_t match_string(unicode text, Py_ssize_t pos, int count):
+    """
+    Matches a string with `count` delimiters on each side, and an optional
+    r prefix. The string can't contain an unescaped delimiter.
+    """
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_UCS4 c, delim
+    cdef int i
+
+    if pos < len_text and text[pos] == u'r':
+        pos += 1
+
+    if pos + count > len_text:
+        return -1
+
+    delim = text[pos]
+
+    if not (delim == u'"' or delim == u"'" or delim == u'`'):
+        return -1
+
+    for i in range(count):
+        if text[pos] != delim:
+            return -1
+
+        pos += 1
+
+    while pos < len_text:
+        c = text[pos]
+
+        if c == delim:
+            break
+
+        if c == u'\\':
+            if pos + 1 >= len_text:
+                return -1
+
+            pos += 2
+            continue
+
+        pos += 1
+
+    for i in range(count):
+        if pos >= len_text or text[pos] != delim:
+            return -1
+
+        pos += 1
+
+    return pos
+
+
+def string(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after the quoted string at `pos`, or -1 if there
+    isn't one.
+    """
+
+    return match_string(text, pos, 1)
+
+
+def triple_string(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after the triple-quoted string at `pos`, or -1 if
+    there isn't one.
+    """
+
+    return match_string(text, pos, 3)
+
+
+cdef Py_ssize_t match_python_string(unicode text, Py_ssize_t pos) except -2:
+    """
+    Matches a Python string, with an optional u and r prefix, returning -1
+    if there isn't one.
+    """
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_UCS4 c, delim
+
+    if pos >= len_text:
+        return -1
+
+    c = text[pos]
+
+    if c == u'u':
+        pos += 1
+
+        if pos == len_text:
+            return -1
+
+        c = text[pos]
+
+    if c == u'r':
+        pos += 1
+
+        if pos == len_text:
+            return -1
+
+        c = text[pos]
+
+    if not (c == u'"' or c == u"'"):
+        return -1
+
+    delim = c
+
+    while True:
+        pos += 1
+
+        if pos >= len_text:
+            raise LexError("end of line reached while parsing string.", len_text)
+
+        c = text[pos]
+
+        if c == delim:
+            break
+
+        if c == u'\\':
+            pos += 1
+
+    return pos + 1
+
+
+def python_string(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after the Python string at `pos`, or -1 if there
+    isn't one. Raises LexError if the string isn't terminated.
+    """
+
+    return match_python_string(text, pos)
+
+
+cdef Py_ssize_t match_delimited_python(unicode text, Py_ssize_t pos, unicode delim) except -2:
+    """
+    Returns the position of the first character in `delim` that isn't part
+    of a string or bracketed expression.
+    """
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_ssize_t end
+    cdef Py_UCS4 c
+
+    while True:
+        pos = skip_whitespace(text, pos)
+
+        if pos >= len_text:
+            break
+
+        c = text[pos]
+
+        if c in delim:
+            return pos
+
+        if c == u'"' or c == u"'":
+            pos = match_python_string(text, pos)
+            continue
+
+        end = match_parenthesised_python(text, pos)
+
+        if end >= 0:
+            pos = end
+            continue
+
+        pos += 1
+
+    raise LexError("reached end of line when expecting '%s'." % delim, len_text)
+
+
+def delimited_python(unicode text, Py_ssize_t pos, delim):
+    """
+    Returns the position of the delimiter that ends the Python code at
+    `pos`. Raises LexError if the end of the line is reached first.
+    """
+
+    return match_delimited_python(text, pos, unicode(delim))
+
+
+cdef Py_ssize_t match_parenthesised_python(unicode text, Py_ssize_t pos) except -2:
+
+    cdef Py_UCS4 c = text[pos]
+
+    if c == u'(':
+        return match_delimited_python(text, pos + 1, u')') + 1
+
+    if c == u'[':
+        return match_delimited_python(text, pos + 1, u']') + 1
+
+    if c == u'{':
+        return match_delimited_python(text, pos + 1, u'}') + 1
+
+    return -1
+
+
+def parenthesised_python(unicode text, Py_ssize_t pos):
+    """
+    Returns the position after the bracketed Python expression at `pos`, or
+    -1 if there isn't one.
+    """
+
+    return match_parenthesised_python(text, pos)
+
+
+cdef Py_ssize_t match_operator(unicode text, Py_ssize_t pos):
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_ssize_t end
+    cdef unicode op
+
+    if pos >= len_text:
+        return -1
+
+    for op in operators:
+        if text.startswith(op, pos):
+            return pos + len(op)
+
+    if pos > 0 and is_word(text[pos - 1]):
+        return -1
+
+    for op in word_operators:
+        if text.startswith(op, pos):
+            end = pos + len(op)
+
+            if end < len_text and is_word(text[end]):
+                continue
+
+            return end
+
+    return -1
+
+
+cdef Py_ssize_t match_name(unicode text, Py_ssize_t pos):
+    """
+    Matches a word that isn't a keyword, or the prefix of a string.
+    """
+
+    cdef Py_ssize_t end = match_word(text, pos)
+    cdef unicode rv
+
+    if end == pos:
+        return -1
+
+    rv = text[pos:end]
+
+    if (rv == u"r") or (rv == u"u") or (rv == u"ur"):
+        if end < len(text) and (text[end] == u'"' or text[end] == u"'" or text[end] == u'`'):
+            return -1
+
+    if rv in keywords:
+        return -1
+
+    return end
+
+
+cdef Py_ssize_t match_digits(unicode text, Py_ssize_t pos):
+
+    cdef Py_ssize_t len_text = len(text)
+
+    while pos < len_text and is_digit(text[pos]):
+        pos += 1
+
+    return pos
+
+
+cdef Py_ssize_t match_float(unicode text, Py_ssize_t pos):
+    """
+    Matches (\+|\-)?(\d+\.?\d*|\.\d+)([eE][-+]?\d+)?
+    """
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_ssize_t end
+
+    if pos < len_text and (text[pos] == u'+' or text[pos] == u'-'):
+        pos += 1
+
+    end = match_digits(text, pos)
+
+    if end > pos:
+        pos = end
+
+        if pos < len_text and text[pos] == u'.':
+            pos = match_digits(text, pos + 1)
+
+    elif pos < len_text and text[pos] == u'.':
+        end = match_digits(text, pos + 1)
+
+        if end == pos + 1:
+            return -1
+
+        pos = end
+
+    else:
+        return -1
+
+    if pos < len_text and (text[pos] == u'e' or text[pos] == u'E'):
+        end = pos + 1
+
+        if end < len_text and (text[end] == u'+' or text[end] == u'-'):
+            end += 1
+
+        if match_digits(text, end) > end:
+            pos = match_digits(text, end)
+
+    return pos
+
+
+def simple_expression(unicode text, Py_ssize_t pos, bint comma, bint operator):
+    """
+    Returns the position after the simple expression at `pos`. This is a
+    series of strings, names, numbers, and bracketed expressions, each
+    followed by dotted names and bracketed expressions, and separated by
+    operators if `operator` is true, and commas if `comma` is true.
+
+    Raises LexError if a dot isn't followed by a name, or a string or
+    bracketed expression isn't terminated.
+    """
+
+    cdef Py_ssize_t len_text = len(text)
+    cdef Py_ssize_t end
+
+    while True:
+
+        while True:
+            pos = skip_whitespace(text, pos)
+            end = match_operator(text, pos)
+
+            if end < 0:
+                break
+
+            pos = end
+
+        if pos >= len_text:
+            break
+
+        end = match_python_string(text, pos)
+
+        if end < 0:
+            end = match_name(text, pos)
+
+        if end < 0:
+            end = match_float(text, pos)
+
+        if end < 0:
+            end = match_parenthesised_python(text, pos)
+
+        if end < 0:
+            break
+
+        pos = end
+
+        while True:
+            pos = skip_whitespace(text, pos)
+
+            if pos >= len_text:
+                break
+
+            if text[pos] == u'.':
+                pos = skip_whitespace(text, pos + 1)
+                end = match_word(text, pos)
+
+                if end == pos:
+                    raise LexError("expecting name after dot.", pos)
+
+                pos = end
+                continue
+
+            end = match_parenthesised_python(text, pos)
+
+            if end >= 0:
+                pos = end
+                continue
+
+            break
+
+        if operator:
+            pos = skip_whitespace(text, pos)
+            end = match_operator(text, pos)
 
+            if end >= 0:
+                pos = end
+                continue
 
+        if comma:
+            pos = skip_whitespace(text, pos)
 
+            if pos < len_text and text[pos] == u',':
+                pos += 1
+                continue
 
+        break
 
+    return pos
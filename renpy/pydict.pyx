@@ -1,10 +1,15 @@
+# cython: binding=True
+
 from __future__ import print_function
 
 from libc.stdlib cimport calloc, free
 from cpython.object cimport PyObject
-from cpython.dict cimport PyDict_Next, PyDict_Size
+from cpython.dict cimport PyDict_Next, PyDict_Size, PyDict_GetItem
 from cpython.ref cimport Py_XINCREF, Py_XDECREF
 
+import weakref
+import renpy
+
 
 cdef struct Item:
     PyObject *key
@@ -178,3 +183,125 @@ def find_changes(DictItems old, DictItems new, object deleted):
             op += 1
 
     return rv
+
+
+def mutator(method):
+    """
+    Wraps `method`, a method of one of the revertable types, so that the
+    object is logged as mutated, along with a clean copy of it, the first
+    time it's changed during a rollback period.
+    """
+
+    def do_mutation(self, *args, **kwargs):
+
+        cdef dict mutated = renpy.game.log.mutated
+
+        if id(self) not in mutated:
+            mutated[id(self)] = (weakref.ref(self), self._clean())
+            renpy.python.mutate_flag = True
+
+        return method(self, *args, **kwargs)
+
+    do_mutation.__name__ = method.__name__
+    do_mutation.__doc__ = method.__doc__
+
+    return do_mutation
+
+
+def compress_list(list old, list new):
+    """
+    Finds a run of objects that's in both `old` and `new`, starting from
+    a pivot near the middle of `new`. Returns an (old_start, old_end,
+    new_start, new_end) tuple giving the run, or None if the pivot isn't
+    found in `old`.
+    """
+
+    cdef Py_ssize_t len_old = len(old)
+    cdef Py_ssize_t len_new = len(new)
+
+    cdef Py_ssize_t new_center = (len_new - 1) // 2
+    cdef Py_ssize_t old_half = (len_old - 1) // 2
+    cdef Py_ssize_t old_center = -1
+    cdef Py_ssize_t i
+
+    cdef Py_ssize_t old_start, old_end, new_start, new_end
+
+    new_pivot = new[new_center]
+
+    for 0 <= i <= old_half:
+
+        if old[old_half - i] is new_pivot:
+            old_center = old_half - i
+            break
+
+        if old_half + i < len_old and old[old_half + i] is new_pivot:
+            old_center = old_half + i
+            break
+
+    if old_center < 0:
+        return None
+
+    new_start = new_center
+    new_end = new_center + 1
+
+    old_start = old_center
+    old_end = old_center + 1
+
+    while new_start and old_start and (new[new_start - 1] is old[old_start - 1]):
+        new_start -= 1
+        old_start -= 1
+
+    while (new_end < len_new) and (old_end < len_old) and (new[new_end] is old[old_end]):
+        new_end += 1
+        old_end += 1
+
+    return old_start, old_end, new_start, new_end
+
+
+def compress_dict(list old, dict new):
+    """
+    Compares `old`, a list of (key, value) pairs, with the dictionary `new`.
+    Returns a (changed, added, reordered) tuple, where changed is a list of
+    the pairs in old whose key is missing from new or maps to a different
+    object, and added is a list of the keys in new that are not in old.
+    reordered is true if restoring changed into new won't put the keys back
+    in the order they have in old, because a key was removed, or removed
+    and added again.
+    """
+
+    cdef list changed = [ ]
+    cdef list added = [ ]
+    cdef dict old_dict = { }
+    cdef list old_keys = [ ]
+    cdef bint reordered = False
+    cdef int i = 0
+
+    cdef PyObject *value
+
+    for k, v in old:
+        old_dict[k] = v
+
+        value = PyDict_GetItem(new, k)
+
+        if value == NULL:
+            changed.append((k, v))
+            reordered = True
+
+        else:
+            old_keys.append(k)
+
+            if <object> value is not v:
+                changed.append((k, v))
+
+    for k in dict.keys(new):
+        if k not in old_dict:
+            added.append(k)
+
+        elif not reordered:
+            ok = old_keys[i]
+            i += 1
+
+            if (ok is not k) and (ok != k):
+                reordered = True
+
+    return changed, added, reordered
@@ -41,7 +41,7 @@ import time
 import io
 import types
 import copyreg
-import functools
+import dis
 
 import renpy.audio
 
@@ -121,6 +121,71 @@ from renpy.pydict import DictItems, find_changes
 EMPTY_DICT = { }
 EMPTY_SET = set()
 
+# The names that code compiled by Ren'Py stores to or deletes with the
+# STORE_GLOBAL and DELETE_GLOBAL opcodes, as functions that declare a
+# variable global do. These write to the store dict directly, without
+# going through StoreDict.__setitem__, so the values of these names are
+# compared when changes are computed.
+global_names = set()
+
+STORE_GLOBAL = dis.opmap["STORE_GLOBAL"]
+DELETE_GLOBAL = dis.opmap["DELETE_GLOBAL"]
+
+
+def find_global_names(code, rv):
+    """
+    Adds the names that `code` and the code objects nested inside it
+    store or delete as globals to the set `rv`.
+    """
+
+    if PY2:
+
+        co_code = bytearray(code.co_code)
+        extended = 0
+        i = 0
+
+        while i < len(co_code):
+            op = co_code[i]
+
+            if op < dis.HAVE_ARGUMENT:
+                i += 1
+                continue
+
+            arg = co_code[i + 1] + co_code[i + 2] * 256 + extended
+            extended = 0
+            i += 3
+
+            if op == dis.EXTENDED_ARG:
+                extended = arg * 65536
+            elif (op == STORE_GLOBAL) or (op == DELETE_GLOBAL):
+                rv.add(code.co_names[arg])
+
+    else:
+
+        for i in dis.get_instructions(code):
+            if (i.opcode == STORE_GLOBAL) or (i.opcode == DELETE_GLOBAL):
+                rv.add(i.argval)
+
+    for i in code.co_consts:
+        if isinstance(i, types.CodeType):
+            find_global_names(i, rv)
+
+
+def note_global_names(code):
+    """
+    Called with each code object that's compiled or loaded, to add the
+    names it stores as globals to global_names.
+    """
+
+    names = set()
+    find_global_names(code, names)
+
+    for k in names - global_names:
+        global_names.add(k)
+
+        for sd in store_dicts.values():
+            sd.note_global(k)
+
 
 class StoreDict(dict):
     """
@@ -133,29 +198,99 @@ class StoreDict(dict):
 
     def __init__(self):
 
-        # The value of this dictionary at the start of the current
-        # rollback period (when begin() was last called).
-        self.old = DictItems(self)
+        # A map from each key that has been set or deleted since begin()
+        # was last called to its value at that time, or deleted if it did
+        # not exist then.
+        self.old = { }
+
+        # The value of each name in global_names when begin() was last
+        # called, or deleted if it did not exist then.
+        self.old_globals = { }
+
+        # A snapshot of the whole dictionary when begin() was last called,
+        # if config.diff_whole_store is set, or None.
+        self.snapshot = None
 
         # The set of variables in this StoreDict that changed since the
         # end of the init phase.
         self.ever_been_changed = set()
 
+    def __setitem__(self, key, value):
+        if key not in self.old:
+            self.old[key] = dict.get(self, key, deleted)
+
+        dict.__setitem__(self, key, value)
+
+    def __delitem__(self, key):
+        if key not in self.old:
+            self.old[key] = dict.get(self, key, deleted)
+
+        dict.__delitem__(self, key)
+
+    def update(self, *args, **kwargs):
+        for k, v in dict(*args, **kwargs).items():
+            self[k] = v
+
+    def setdefault(self, key, default=None):
+        if key not in self:
+            self[key] = default
+
+        return dict.__getitem__(self, key)
+
+    def pop(self, key, *args):
+        if (key in self) and (key not in self.old):
+            self.old[key] = dict.__getitem__(self, key)
+
+        return dict.pop(self, key, *args)
+
+    def popitem(self):
+        key, value = dict.popitem(self)
+
+        if key not in self.old:
+            self.old[key] = value
+
+        return key, value
+
+    def clear(self):
+        for k, v in dict.items(self):
+            if k not in self.old:
+                self.old[k] = v
+
+        dict.clear(self)
+
+    def note_global(self, key):
+        """
+        Called when `key` is added to global_names, to record the value it
+        had when begin() was called. Since code storing to it as a global
+        has not run yet, that's either logged in old, or unchanged.
+        """
+
+        if key in self.old:
+            self.old_globals[key] = self.old[key]
+        else:
+            self.old_globals[key] = dict.get(self, key, deleted)
+
     def reset(self):
         """
         Called to reset this to its initial conditions.
         """
 
         self.ever_been_changed = set()
-        self.clear()
-        self.old = DictItems(self)
+        dict.clear(self)
+        self.begin()
 
     def begin(self):
         """
         Called to mark the start of a rollback period.
         """
 
-        self.old = DictItems(self)
+        self.old = { }
+        self.old_globals = { k : dict.get(self, k, deleted) for k in global_names }
+
+        if renpy.config.diff_whole_store:
+            self.snapshot = DictItems(self)
+        else:
+            self.snapshot = None
 
     def get_changes(self, cycle):
         """
@@ -171,11 +306,37 @@ class StoreDict(dict):
             False, does not.
         """
 
-        new = DictItems(self)
-        rv = find_changes(self.old, new, deleted)
+        rv = None
+
+        old_globals = self.old_globals
+
+        if self.snapshot is not None:
+            rv = find_changes(self.snapshot, DictItems(self), deleted)
+
+        else:
+
+            # This only needs to look at the keys that were logged when set
+            # or deleted, and the names that may have been set without
+            # logging.
+            for k, v in self.old.items():
+                if k in old_globals:
+                    continue
+
+                if dict.get(self, k, deleted) is not v:
+                    if rv is None:
+                        rv = { }
+
+                    rv[k] = v
+
+            for k, v in old_globals.items():
+                if dict.get(self, k, deleted) is not v:
+                    if rv is None:
+                        rv = { }
+
+                    rv[k] = v
 
         if cycle:
-            self.old = new
+            self.begin()
 
         if rv is None:
             return EMPTY_DICT, EMPTY_SET
@@ -268,8 +429,10 @@ class StoreBackup():
         # The contents of the store for each store.
         self.store = { }
 
-        # The contents of old for each store.
+        # The contents of old, old_globals, and snapshot for each store.
         self.old = { }
+        self.old_globals = { }
+        self.snapshot = { }
 
         # The contents of ever_been_changed for each store.
         self.ever_been_changed = { }
@@ -282,16 +445,24 @@ class StoreBackup():
         d = store_dicts[name]
 
         self.store[name] = dict(d)
-        self.old[name] = d.old.as_dict()
+        self.old[name] = dict(d.old)
+        self.old_globals[name] = dict(d.old_globals)
+        self.snapshot[name] = d.snapshot
         self.ever_been_changed[name] = set(d.ever_been_changed)
 
     def restore_one(self, name):
         sd = store_dicts[name]
 
-        sd.clear()
-        sd.update(self.store[name])
+        dict.clear(sd)
+        dict.update(sd, self.store[name])
 
-        sd.old = DictItems(self.old[name])
+        sd.old = dict(self.old[name])
+        sd.old_globals = dict(self.old_globals[name])
+        sd.snapshot = self.snapshot[name]
+
+        for k in global_names:
+            if k not in sd.old_globals:
+                sd.note_global(k)
 
         sd.ever_been_changed.clear()
         sd.ever_been_changed.update(self.ever_been_changed[name])
@@ -750,7 +921,9 @@ def py_compile(source, mode, filename='<none>', lineno=1, ast_node=False, cache=
         cache = False
 
     if isinstance(source, ast.Module):
-        return compile(source, filename, mode)
+        rv = compile(source, filename, mode)
+        note_global_names(rv)
+        return rv
 
     if isinstance(source, renpy.ast.PyExpr):
         filename = source.filename
@@ -765,14 +938,15 @@ def py_compile(source, mode, filename='<none>', lineno=1, ast_node=False, cache=
 
         rv = old_py_compile_cache.get(key, None)
         if rv is not None:
+            note_global_names(rv)
             py_compile_cache[key] = rv
             return rv
 
-        bytecode = renpy.game.script.bytecode_oldcache.get(key, None)
+        bytecode = renpy.game.script.bytecode_cache.get(key, None)
         if bytecode is not None:
 
-            renpy.game.script.bytecode_newcache[key] = bytecode
             rv = marshal.loads(bytecode)
+            note_global_names(rv)
             py_compile_cache[key] = rv
             return rv
 
@@ -819,11 +993,11 @@ def py_compile(source, mode, filename='<none>', lineno=1, ast_node=False, cache=
             return tree.body
 
         rv = compile(tree, filename, py_mode, flags, 1)
+        note_global_names(rv)
 
         if cache:
             py_compile_cache[key] = rv
-            renpy.game.script.bytecode_newcache[key] = marshal.dumps(rv)
-            renpy.game.script.bytecode_dirty = True
+            renpy.game.script.bytecode_cache.add(key, marshal.dumps(rv))
 
         return rv
 
@@ -859,22 +1033,9 @@ def py_compile_eval_bytecode(source, **kwargs):
 mutate_flag = True
 
 
-def mutator(method):
-
-    @functools.wraps(method, ("__name__", "__doc__"), ())
-    def do_mutation(self, *args, **kwargs):
-
-        global mutate_flag
-
-        mutated = renpy.game.log.mutated # @UndefinedVariable
-
-        if id(self) not in mutated:
-            mutated[id(self)] = (weakref.ref(self), self._clean())
-            mutate_flag = True
-
-        return method(self, *args, **kwargs)
-
-    return do_mutation
+# The mutator wrapper and the list and dict compression helpers are in
+# Cython, as they're run whenever the store is changed.
+from renpy.pydict import mutator, compress_list, compress_dict
 
 
 class CompressedList(object):
@@ -890,24 +1051,10 @@ class CompressedList(object):
 
     def __init__(self, old, new):
 
-        # Pick out a pivot element near the center of the list.
-        new_center = (len(new) - 1) // 2
-        new_pivot = new[new_center]
+        run = compress_list(old, new)
 
-        # Find an element in the old list corresponding to the pivot.
-        old_half = (len(old) - 1) // 2
-
-        for i in range(0, old_half + 1):
-
-            if old[old_half - i] is new_pivot:
-                old_center = old_half - i
-                break
-
-            if old[old_half + i] is new_pivot:
-                old_center = old_half + i
-                break
-        else:
-            # If we couldn't, give up.
+        # If we couldn't find a run in both lists, give up.
+        if run is None:
             self.pre = old
             self.start = 0
             self.end = 0
@@ -915,29 +1062,13 @@ class CompressedList(object):
 
             return
 
-        # Figure out the position of the overlap in the center of the two lists.
-        new_start = new_center
-        new_end = new_center + 1
-
-        old_start = old_center
-        old_end = old_center + 1
-
-        len_new = len(new)
-        len_old = len(old)
-
-        while new_start and old_start and (new[new_start - 1] is old[old_start - 1]):
-            new_start -= 1
-            old_start -= 1
-
-        while (new_end < len_new) and (old_end < len_old) and (new[new_end] is old[old_end]):
-            new_end += 1
-            old_end += 1
+        old_start, old_end, new_start, new_end = run
 
         # Now that we have this, we can put together the object.
         self.pre = list.__getitem__(old, slice(0, old_start))
         self.start = new_start
         self.end = new_end
-        self.post = list.__getitem__(old, slice(old_end, len_old))
+        self.post = list.__getitem__(old, slice(old_end, len(old)))
 
     def decompress(self, new):
         return self.pre + new[self.start:self.end] + self.post
@@ -1048,6 +1179,45 @@ class RevertableList(list):
             self[:] = compressed
 
 
+class CompressedDict(object):
+    """
+    Compresses the changes to a dictionary. This stores the items of the
+    old dictionary that are missing or different in the new one, and the
+    keys that were added to the new one. If keys were removed, the order of
+    the old keys is stored as well, so it can be restored.
+    """
+
+    # The keys of the old dictionary, in order, if restoring the changes
+    # would leave them in a different order.
+    order = None
+
+    def __init__(self, old, new):
+        self.changed, self.added, reordered = compress_dict(old, new)
+
+        # Dictionaries are only ordered on Python 3.
+        if reordered and not PY2:
+            self.order = [ k for k, _v in old ]
+
+    def decompress(self, new):
+        """
+        Changes `new` back into the old dictionary.
+        """
+
+        for k in self.added:
+            del new[k]
+
+        for k, v in self.changed:
+            new[k] = v
+
+        if self.order is not None:
+            items = [ (k, new[k]) for k in self.order ]
+            new.clear()
+            new.update(items)
+
+    def __repr__(self):
+        return "<CompressedDict {} {}>".format(self.changed, self.added)
+
+
 def revertable_range(*args):
     return RevertableList(range(*args))
 
@@ -1106,12 +1276,27 @@ class RevertableDict(dict):
         return rv
 
     def _clean(self):
-        return list(self.items())
+        return list(dict.items(self))
 
     def _compress(self, clean):
-        return clean
+
+        if not self or not clean:
+            return clean
+
+        if renpy.config.dict_compression_length is None:
+            return clean
+
+        if len(self) < renpy.config.dict_compression_length or len(clean) < renpy.config.dict_compression_length:
+            return clean
+
+        return CompressedDict(clean, self)
 
     def _rollback(self, compressed):
+
+        if isinstance(compressed, CompressedDict):
+            compressed.decompress(self)
+            return
+
         self.clear()
 
         for k, v in compressed:
@@ -1350,6 +1535,73 @@ generation = time.time()
 serial = 0
 
 
+def held_size(obj):
+    """
+    Returns an estimate of the bytes used by `obj`, a value stored by a
+    rollback, and the objects it holds directly.
+    """
+
+    rv = sys.getsizeof(obj, 0)
+
+    if isinstance(obj, CompressedList):
+        items = obj.pre + obj.post
+    elif isinstance(obj, CompressedDict):
+        items = [ v for _k, v in obj.changed ]
+    elif isinstance(obj, dict):
+        items = obj.values()
+    elif isinstance(obj, (list, tuple, set, frozenset)):
+        items = obj
+    else:
+        return rv
+
+    for i in items:
+        rv += sys.getsizeof(i, 0)
+
+    return rv
+
+
+def unreachable_size(obj, reachable):
+    """
+    Returns an estimate of the bytes used by `obj` and the objects it
+    refers to, not counting the objects in `reachable`, a map like the
+    one passed to reached. The objects that are counted are added to
+    `reachable`, so they're only counted once.
+    """
+
+    idobj = id(obj)
+
+    if idobj in reachable:
+        return 0
+
+    reachable[idobj] = 1
+
+    if isinstance(obj, (NoRollback, io.IOBase, StoreModule)): # @UndefinedVariable
+        return 0
+
+    rv = sys.getsizeof(obj, 0)
+
+    try:
+        for v in vars(obj).values():
+            rv += unreachable_size(v, reachable)
+    except:
+        pass
+
+    try:
+        if not isinstance(obj, basestring):
+            for v in obj.__iter__():
+                rv += unreachable_size(v, reachable)
+    except:
+        pass
+
+    try:
+        for v in obj.values():
+            rv += unreachable_size(v, reachable)
+    except:
+        pass
+
+    return rv
+
+
 class Rollback(renpy.object.Object):
     """
     Allows the state of the game to be rolled back to the point just
@@ -1384,6 +1636,15 @@ class Rollback(renpy.object.Object):
     identifier = None
     not_greedy = False
 
+    # The estimated size of the data in this rollback, in bytes, or None if
+    # it hasn't been computed.
+    size = None
+
+    # True if size was computed by measure_size.
+    measured = False
+
+    nosave = [ 'size', 'measured' ]
+
     def __init__(self):
 
         super(Rollback, self).__init__()
@@ -1499,8 +1760,53 @@ class Rollback(renpy.object.Object):
         del self.objects[:]
         self.objects.extend(new_objects)
 
+        self.size = None
+        self.measured = False
+
         return True
 
+    def get_size(self):
+        """
+        Returns an estimate of the number of bytes used by the data this
+        rollback stores to undo changes. Unless measure_size has been
+        called, this is computed once, from the old values of the store
+        variables and the data the changed objects use to roll back, and
+        the objects they hold directly.
+        """
+
+        if self.size is not None:
+            return self.size
+
+        rv = sys.getsizeof(self.objects)
+
+        for _o, compressed in self.objects:
+            rv += held_size(compressed)
+
+        for changes in self.stores.values():
+            rv += held_size(changes)
+
+        self.size = rv
+        return rv
+
+    def measure_size(self, reachable):
+        """
+        Replaces the size estimate with one that counts everything the
+        data this rollback stores refers to, except for the objects in
+        `reachable`, a map of the objects reachable from the current state
+        of the game. Objects that are counted are added to `reachable`.
+        """
+
+        rv = sys.getsizeof(self.objects)
+
+        for _o, compressed in self.objects:
+            rv += unreachable_size(compressed, reachable)
+
+        for changes in self.stores.values():
+            rv += unreachable_size(changes, reachable)
+
+        self.size = rv
+        self.measured = True
+
     def rollback(self):
         """
         Reverts the state of the game to what it was at the start of the
@@ -1670,6 +1976,26 @@ class RollbackLog(renpy.object.Object):
         while len(self.log) > renpy.config.rollback_length:
             self.log.pop(0)
 
+        # If the log uses too much memory, prune it, keeping the last two
+        # entries so it's possible to roll back to the last statement.
+        limit = renpy.config.rollback_memory_limit
+
+        if limit is not None:
+
+            size = self.get_size()
+
+            # Measuring walks the whole game state, so it's only done when
+            # enough unmeasured entries have built up, not every statement.
+            if size > limit:
+                unmeasured = sum(i.get_size() for i in self.log if not i.measured)
+
+                if unmeasured > limit // 4:
+                    self.measure_size()
+                    size = self.get_size()
+
+            while (len(self.log) > 2) and (size > limit):
+                size -= self.log.pop(0).get_size()
+
         # check for the end of fixed rollback
         if self.log and self.log[-1] == self.current:
 
@@ -1695,6 +2021,27 @@ class RollbackLog(renpy.object.Object):
 
         self.rolled_forward = False
 
+    def get_size(self):
+        """
+        Returns an estimate of the number of bytes used by the rollback log.
+        """
+
+        return sum(i.get_size() for i in self.log)
+
+    def measure_size(self):
+        """
+        Measures the size of the entries in the log that haven't been
+        measured, not counting the objects that are reachable from the
+        current state of the game.
+        """
+
+        reachable = { }
+        reached_vars(self.get_roots(), reachable, None)
+
+        for i in reversed(self.log):
+            if not i.measured:
+                i.measure_size(reachable)
+
     def replace_node(self, old, new):
         """
         Replaces references to the `old` ast node with a reference to the
@@ -1720,6 +2067,9 @@ class RollbackLog(renpy.object.Object):
             self.checkpoint(hard=False)
             self.force_checkpoint = False
 
+        self.current.size = None
+        self.current.measured = False
+
         # Update self.current.stores with the changes from each store.
         # Also updates .ever_been_changed.
         for name, sd in store_dicts.items():
@@ -30,11 +30,13 @@ from renpy.compat import *
 import os
 import zipfile
 import json
+import zlib
+import struct
 
 import renpy.display
 import threading
 
-from renpy.loadsave import clear_slot, safe_rename
+from renpy.loadsave import clear_slot, safe_rename, dumps, loads, join_chunks
 import shutil
 
 disk_lock = threading.RLock()
@@ -84,6 +86,30 @@ class FileLocation(object):
         # The data loaded from the persistent file.
         self.persistent_data = None
 
+        # The directory holding the chunks that make up the logs of chunked
+        # saves.
+        self.chunk_directory = os.path.join(self.directory, "chunks")
+
+        # A map from slotname to an (mtime, digests) tuple, giving the set
+        # of chunks used by the save in that slot.
+        self.chunk_refs = { }
+
+        # The index file, which caches the mtime, json, and screenshot of
+        # each slot, so they can be read without opening every save file.
+        self.index_filename = os.path.join(self.directory, "saveindex")
+
+        # A map from slotname to an (mtime, json, screenshot, screenshot
+        # filename) tuple, loaded from the index file.
+        self.index = { }
+
+        # The mtime of the index file when it was last read or written.
+        self.index_mtime = None
+
+        # The number of records in the index file, and True if the file ends
+        # with a record that couldn't be read.
+        self.index_records = 0
+        self.index_damaged = False
+
     def filename(self, slotname):
         """
         Given a slot name, returns a filename.
@@ -156,11 +182,19 @@ class FileLocation(object):
         filename = self.filename(slotname)
 
         with disk_lock:
-            record.write_file(filename)
+            record.write_file(filename, self.chunk_directory)
 
         self.sync()
         self.scan()
 
+        mtime = self.mtime(slotname)
+
+        if mtime is not None:
+            self.update_index({ slotname : (mtime, record.json, record.screenshot, "screenshot.png") })
+
+        # Overwriting a save can leave chunks unused.
+        self.collect_chunks()
+
     def list(self):
         """
         Returns a list of all slots with savefiles in them, in arbitrary
@@ -179,40 +213,166 @@ class FileLocation(object):
 
         return self.mtimes.get(slotname, None)
 
-    def json(self, slotname):
+    def load_index(self):
         """
-        Returns the JSON data for slotname.
+        Loads the index file, if it's changed since it was last read.
 
-        Returns None if the slot is empty.
+        The index file is a series of records, each a length and crc32
+        followed by a pickled dict mapping slotnames to new entries, or to
+        None if the entry was removed. Records are only ever appended, so
+        reading stops at the first damaged record.
         """
 
         with disk_lock:
 
             try:
-                filename = self.filename(slotname)
-                with zipfile.ZipFile(filename, "r") as zf:
+                mtime = os.path.getmtime(self.index_filename)
+            except:
+                mtime = None
+
+            if mtime == self.index_mtime:
+                return
+
+            self.index = { }
+            self.index_mtime = mtime
+            self.index_records = 0
+            self.index_damaged = False
+
+            if mtime is None:
+                return
+
+            try:
+                with open(self.index_filename, "rb") as f:
+                    data = f.read()
+            except:
+                return
+
+            pos = 0
+
+            while pos < len(data):
+
+                try:
+                    length, crc = struct.unpack_from("<II", data, pos)
+                    record = data[pos + 8:pos + 8 + length]
+
+                    if len(record) != length or (zlib.crc32(record) & 0xffffffff) != crc:
+                        raise Exception("Damaged record.")
+
+                    changes = loads(record)
+
+                except:
+                    self.index_damaged = True
+                    break
+
+                for slotname, entry in changes.items():
+                    if entry is None:
+                        self.index.pop(slotname, None)
+                    else:
+                        self.index[slotname] = entry
+
+                self.index_records += 1
+                pos += 8 + length
+
+    def update_index(self, changes):
+        """
+        Applies `changes`, a dict mapping slotname to an entry or None, to
+        the index, and writes it to the index file. The changes are appended
+        as a single record, unless the file has accumulated too many stale
+        records, in which case it's rewritten.
+        """
+
+        with disk_lock:
+
+            self.load_index()
+
+            for slotname, entry in changes.items():
+                if entry is None:
+                    self.index.pop(slotname, None)
+                else:
+                    self.index[slotname] = entry
+
+            try:
+
+                if self.index_damaged or (self.index_records > 2 * len(self.index) + 16):
+
+                    # Drop the entries of slots that no longer exist.
+                    self.index = { k : v for k, v in self.index.items() if k in self.mtimes }
+
+                    data = dumps(self.index)
+                    data = struct.pack("<II", len(data), zlib.crc32(data) & 0xffffffff) + data
+
+                    fn_tmp = self.index_filename + tmp
+
+                    with open(fn_tmp, "wb") as f:
+                        f.write(data)
+
+                    safe_rename(fn_tmp, self.index_filename)
+
+                    self.index_records = 1
+                    self.index_damaged = False
+
+                else:
+
+                    data = dumps(changes)
+                    data = struct.pack("<II", len(data), zlib.crc32(data) & 0xffffffff) + data
+
+                    with open(self.index_filename, "ab") as f:
+                        f.write(data)
+
+                    self.index_records += 1
+
+                self.index_mtime = os.path.getmtime(self.index_filename)
+
+            except:
+                # The index is only a cache, so if it can't be written, force
+                # it to be rewritten next time.
+                self.index_damaged = True
+
+            self.sync()
+
+    def read_entry(self, slotname, mtime):
+        """
+        Reads the index entry for slotname from the save file, or returns
+        None if the save file can't be read.
+        """
+
+        try:
+            with zipfile.ZipFile(self.filename(slotname), "r") as zf:
+
+                try:
+                    data = zf.read("json")
+                    json.loads(data)
+                except:
+
                     try:
-                        data = zf.read("json")
-                        data = json.loads(data)
-                        return data
+                        extra_info = zf.read("extra_info").decode("utf-8")
+                        data = { "_save_name" : extra_info }
                     except:
-                        pass
+                        data = { }
+
+                    data = json.dumps(data)
+
+                screenshot = None
+                screenshot_filename = None
 
+                for i in [ "screenshot.png", "screenshot.tga" ]:
                     try:
-                        extra_info = zf.read("extra_info").decode("utf-8")
-                        return { "_save_name" : extra_info }
+                        screenshot = zf.read(i)
+                        screenshot_filename = i
+                        break
                     except:
                         pass
 
-                    return { }
-            except:
-                return None
+        except:
+            return None
 
-    def screenshot(self, slotname):
-        """
-        Returns a displayable that show the screenshot for this slot.
+        return (mtime, data, screenshot, screenshot_filename)
 
-        Returns None if the slot is empty.
+    def index_entry(self, slotname):
+        """
+        Returns the index entry for slotname, reading it from the save file
+        and adding it to the index if the index doesn't have an up-to-date
+        entry. Returns None if the slot is empty.
         """
 
         with disk_lock:
@@ -222,24 +382,50 @@ class FileLocation(object):
             if mtime is None:
                 return None
 
-            try:
-                filename = self.filename(slotname)
-                with zipfile.ZipFile(filename, "r") as zf:
-                    try:
-                        png = False
-                        zf.getinfo('screenshot.tga')
-                    except:
-                        png = True
-                        zf.getinfo('screenshot.png')
-            except:
-                return None
+            self.load_index()
+
+            entry = self.index.get(slotname, None)
+
+            if (entry is not None) and (entry[0] == mtime):
+                return entry
+
+            entry = self.read_entry(slotname, mtime)
+
+            if entry is not None:
+                self.update_index({ slotname : entry })
+
+            return entry
+
+    def json(self, slotname):
+        """
+        Returns the JSON data for slotname.
+
+        Returns None if the slot is empty.
+        """
+
+        entry = self.index_entry(slotname)
+
+        if entry is None:
+            return None
+
+        try:
+            return json.loads(entry[1])
+        except:
+            return { }
 
-            if png:
-                screenshot = renpy.display.im.ZipFileImage(filename, "screenshot.png", mtime)
-            else:
-                screenshot = renpy.display.im.ZipFileImage(filename, "screenshot.tga", mtime)
+    def screenshot(self, slotname):
+        """
+        Returns a displayable that show the screenshot for this slot.
+
+        Returns None if the slot is empty.
+        """
+
+        entry = self.index_entry(slotname)
+
+        if (entry is None) or (entry[2] is None):
+            return None
 
-            return screenshot
+        return renpy.display.im.Data(entry[2], entry[3])
 
     def load(self, slotname):
         """
@@ -252,9 +438,67 @@ class FileLocation(object):
             filename = self.filename(slotname)
 
             with zipfile.ZipFile(filename, "r") as zf:
-                rv = zf.read("log")
+                if "chunks" not in zf.namelist():
+                    return zf.read("log")
 
-            return rv
+                digests = zf.read("chunks").decode("utf-8").split()
+                roots_index = int(zf.read("chunks_roots").decode("utf-8"))
+
+            rv = [ ]
+
+            for i in digests:
+                with open(os.path.join(self.chunk_directory, i), "rb") as f:
+                    rv.append(zlib.decompress(f.read()))
+
+            return join_chunks(rv, roots_index)
+
+    def collect_chunks(self):
+        """
+        Deletes the chunks that aren't used by any save in this location.
+        """
+
+        with disk_lock:
+
+            if not os.path.isdir(self.chunk_directory):
+                return
+
+            refs = { }
+            used = set()
+
+            for slotname, mtime in self.mtimes.items():
+
+                old = self.chunk_refs.get(slotname, None)
+
+                if (old is not None) and (old[0] == mtime):
+                    digests = old[1]
+
+                else:
+
+                    try:
+                        with zipfile.ZipFile(self.filename(slotname), "r") as zf:
+                            if "chunks" in zf.namelist():
+                                digests = frozenset(zf.read("chunks").decode("utf-8").split())
+                            else:
+                                digests = frozenset()
+                    except:
+                        # Keep every chunk if a save can't be read.
+                        return
+
+                refs[slotname] = (mtime, digests)
+                used.update(digests)
+
+            self.chunk_refs = refs
+
+            for fn in os.listdir(self.chunk_directory):
+                if fn in used:
+                    continue
+
+                try:
+                    os.unlink(os.path.join(self.chunk_directory, fn))
+                except:
+                    pass
+
+            self.sync()
 
     def unlink(self, slotname):
         """
@@ -270,6 +514,10 @@ class FileLocation(object):
             self.sync()
             self.scan()
 
+            if slotname in self.index:
+                self.update_index({ slotname : None })
+            self.collect_chunks()
+
     def rename(self, old, new):
         """
         If old exists, renames it to new.
@@ -277,12 +525,18 @@ class FileLocation(object):
 
         with disk_lock:
 
+            old_slotname = old
+            new_slotname = new
+
             old = self.filename(old)
             new = self.filename(new)
 
             if not os.path.exists(old):
                 return
 
+            self.load_index()
+            entry = self.index.get(old_slotname, None)
+
             os.rename(old, old + ".tmp")
             old = old + ".tmp"
 
@@ -294,23 +548,39 @@ class FileLocation(object):
             self.sync()
             self.scan()
 
+            # Renaming keeps the mtime, so the entry stays valid.
+            self.update_index({ old_slotname : None, new_slotname : entry })
+            self.collect_chunks()
+
     def copy(self, old, new):
         """
         Copies `old` to `new`, if `old` exists.
         """
 
         with disk_lock:
+
+            old_slotname = old
+            new_slotname = new
+
             old = self.filename(old)
             new = self.filename(new)
 
             if not os.path.exists(old):
                 return
 
+            self.load_index()
+            entry = self.index.get(old_slotname, None)
+
             shutil.copyfile(old, new)
 
             self.sync()
             self.scan()
 
+            mtime = self.mtime(new_slotname)
+
+            if (entry is not None) and (entry[0] == self.mtime(old_slotname)) and (mtime is not None):
+                self.update_index({ new_slotname : (mtime, ) + entry[1:] })
+
     def load_persistent(self):
         """
         Returns a list of (mtime, persistent) tuples loaded from the
@@ -35,6 +35,13 @@ import time
 import marshal
 import struct
 import zlib
+import threading
+import collections
+
+try:
+    import mmap
+except ImportError:
+    mmap = None
 
 from renpy.compat.pickle import loads, dumps
 import shutil
@@ -43,7 +50,7 @@ import shutil
 script_version = renpy.script_version
 
 # The version of the bytecode cache.
-BYTECODE_VERSION = 1
+BYTECODE_VERSION = 2
 
 # The python magic code.
 MAGIC = imp.get_magic()
@@ -54,6 +61,254 @@ RPYC2_HEADER = b"RENPY RPC2"
 # A string
 BYTECODE_FILE = "cache/bytecode.rpyb"
 
+# A string at the start of the bytecode cache file, which includes
+# BYTECODE_VERSION.
+BYTECODE_HEADER = b"RENPY RPB2\n"
+
+
+class BytecodeCache(object):
+    """
+    The cache of compiled Python code. This is stored in BYTECODE_FILE,
+    which is BYTECODE_HEADER followed by a series of entries. Each entry
+    is the sha1 digest of its key and the length of its data, packed as
+    "<20sI", followed by the data, which is the zlib-compressed marshalled
+    code.
+
+    Only the entry headers are read at startup. When the file is on disk,
+    it's accessed through mmap where that's available, and an entry is
+    only decompressed when it's used.
+    """
+
+    def __init__(self):
+
+        # The mmap or bytes object the entries are read from.
+        self.data = None
+
+        # A map from digest to the (offset, length) of the entry in data.
+        self.index = { }
+
+        # The offset of the end of the last complete entry.
+        self.end = 0
+
+        # The file the data was read from, or None if it didn't come from a
+        # file on disk.
+        self.filename = None
+
+        # True if data is an mmap that has to be closed.
+        self.mapped = False
+
+        # A map from digest to marshalled code, for entries read from a
+        # version 1 cache.
+        self.legacy = { }
+
+        # A map from digest to marshalled code, for entries that have been
+        # compiled, and aren't in the file.
+        self.new = { }
+
+        # The digests of the entries that have been used.
+        self.used = set()
+
+        # The number of entries that have been decompressed.
+        self.loaded = 0
+
+        # If true, entries that haven't been used are kept when the file is
+        # saved, as they may be used by blocks that are loaded later.
+        self.keep_unused = False
+
+    def digest(self, key):
+        return hashlib.sha1(repr(key).encode("utf-8")).digest()
+
+    def close(self):
+
+        if self.mapped:
+            self.data.close()
+
+        self.data = None
+        self.filename = None
+        self.mapped = False
+        self.index = { }
+        self.end = 0
+
+    def load(self):
+        """
+        Loads the index of the cache file.
+        """
+
+        self.close()
+
+        try:
+
+            try:
+                fn = renpy.loader.transfn(BYTECODE_FILE)
+            except:
+                fn = None
+
+            if fn is not None:
+                with open(fn, "rb") as f:
+                    self.filename = fn
+
+                    # Platforms without mmap, and empty files, fall back
+                    # to reading the file.
+                    if mmap is not None:
+                        try:
+                            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+                            self.mapped = True
+                        except:
+                            pass
+
+                    if not self.mapped:
+                        self.data = f.read()
+            else:
+                with renpy.loader.load(BYTECODE_FILE) as f:
+                    self.data = f.read()
+
+        except:
+            self.close()
+            return
+
+        data = self.data
+        size = len(data)
+
+        if data[:len(BYTECODE_HEADER)] != BYTECODE_HEADER:
+
+            try:
+                version, cache = loads(zlib.decompress(data[:]))
+                if version == 1:
+                    self.legacy = { self.digest(k) : v for k, v in cache.items() }
+            except:
+                pass
+
+            self.close()
+            return
+
+        pos = len(BYTECODE_HEADER)
+
+        while pos + 24 <= size:
+            digest, length = struct.unpack_from("<20sI", data, pos)
+
+            if pos + 24 + length > size:
+                break
+
+            self.index[digest] = (pos + 24, length)
+            pos += 24 + length
+
+        self.end = pos
+
+    def get(self, key, default=None):
+        """
+        Returns the marshalled code for `key`, or `default` if it's not in
+        the cache.
+        """
+
+        digest = self.digest(key)
+
+        rv = self.new.get(digest, None)
+
+        if rv is None:
+            rv = self.legacy.get(digest, None)
+
+        if (rv is None) and (digest in self.index):
+            offset, length = self.index[digest]
+
+            try:
+                rv = zlib.decompress(self.data[offset:offset + length])
+                self.loaded += 1
+            except:
+                rv = None
+
+        if rv is None:
+            return default
+
+        self.used.add(digest)
+        return rv
+
+    def add(self, key, code):
+        """
+        Adds newly compiled marshalled `code` for `key` to the cache.
+        """
+
+        digest = self.digest(key)
+
+        self.new[digest] = code
+        self.used.add(digest)
+
+    def save(self):
+        """
+        Writes the entries that have been used to the cache file. New
+        entries are appended to the file, unless it's mostly made up of
+        entries that weren't used, in which case it's rewritten.
+        """
+
+        fn = renpy.loader.get_path(BYTECODE_FILE)
+
+        missing = [ i for i in self.used if i not in self.index ]
+        stale = len(self.index) - len(self.used) + len(missing)
+
+        renpy.display.log.write("Bytecode cache: %d entries, %d decompressed, %d compiled, %d unused.", len(self.index), self.loaded, len(self.new), stale)
+
+        # Entries can only be appended to a file that was read from where
+        # the cache is saved.
+        rewrite = (self.filename is None) or (os.path.abspath(self.filename) != os.path.abspath(fn)) or ((stale > len(self.used)) and not self.keep_unused)
+
+        if not (missing or rewrite):
+            return
+
+        entries = [ ]
+
+        if self.keep_unused:
+            digests = self.used | set(self.index)
+        else:
+            digests = self.used
+
+        for digest in sorted(digests):
+
+            if digest in self.index:
+                if rewrite:
+                    offset, length = self.index[digest]
+                    entries.append((digest, self.data[offset:offset + length]))
+
+            else:
+                code = self.new.get(digest, None)
+
+                if code is None:
+                    code = self.legacy[digest]
+
+                entries.append((digest, zlib.compress(code, 3)))
+
+        end = self.end
+
+        # The file can't be changed while it's mapped on some platforms.
+        self.close()
+
+        if rewrite:
+            with open(fn + ".new", "wb") as f:
+                f.write(BYTECODE_HEADER)
+
+                for digest, data in entries:
+                    f.write(struct.pack("<20sI", digest, len(data)))
+                    f.write(data)
+
+            if os.path.exists(fn):
+                os.unlink(fn)
+
+            os.rename(fn + ".new", fn)
+
+        else:
+
+            # Remove any partial entry left by an interrupted write.
+            with open(fn, "r+b") as f:
+                f.seek(end)
+                f.truncate()
+
+                for digest, data in entries:
+                    f.write(struct.pack("<20sI", digest, len(data)))
+                    f.write(data)
+
+        self.new = { }
+        self.legacy = { }
+
+        self.load()
+
 
 class ScriptError(Exception):
     """
@@ -76,6 +331,125 @@ def collapse_stmts(stmts):
     return rv
 
 
+# The number of threads that read .rpyc files, and the number of files they
+# can read ahead of the file being loaded.
+RPYC_THREADS = 4
+RPYC_LOOKAHEAD = 16
+
+
+class RpycPrefetcher(object):
+    """
+    Reads and decompresses .rpyc files on a pool of threads, ahead of the
+    main thread, which unpickles them and calls finish_load in order.
+    zlib releases the GIL while decompressing, so this uses multiple cores,
+    and overlaps I/O with the rest of loading.
+    """
+
+    def __init__(self, script, files):
+
+        self.script = script
+
+        # The filenames that haven't been read yet, in load order.
+        self.pending = collections.deque()
+
+        # A map from filename to an event that's set when the file has
+        # been read.
+        self.events = { }
+
+        # A map from filename to a (slot, data) tuple, or None if the file
+        # couldn't be read.
+        self.results = { }
+
+        # A map from filename to the slots to try reading, in order.
+        self.slots = { }
+
+        for fn, slots in files:
+            if fn not in self.events:
+                self.pending.append(fn)
+                self.events[fn] = threading.Event()
+                self.slots[fn] = slots
+
+        self.lock = threading.Lock()
+
+        # Limits how far the threads can get ahead of the main thread.
+        self.window = threading.Semaphore(RPYC_LOOKAHEAD)
+
+        self.quit = False
+
+        self.threads = [ ]
+
+        for _i in range(min(RPYC_THREADS, len(self.pending))):
+            t = threading.Thread(target=self.run)
+            t.daemon = True
+            t.start()
+
+            self.threads.append(t)
+
+    def run(self):
+
+        while True:
+
+            self.window.acquire()
+
+            with self.lock:
+                if self.quit or not self.pending:
+                    self.window.release()
+                    return
+
+                fn = self.pending.popleft()
+                event = self.events[fn]
+
+            try:
+                self.results[fn] = self.script.prefetch_rpyc(fn, self.slots[fn])
+            except:
+                self.results[fn] = None
+
+            event.set()
+
+    def get(self, fn):
+        """
+        Returns the (slot, data) tuple read from `fn`, or None if `fn`
+        wasn't read.
+        """
+
+        event = self.events.get(fn, None)
+
+        if event is None:
+            return None
+
+        event.wait()
+
+        return self.results.pop(fn, None)
+
+    def done(self, fn):
+        """
+        Called when the main thread is done with `fn`, whether or not it
+        used the data that was read, to let the threads read another file.
+        """
+
+        event = self.events.get(fn, None)
+
+        if event is None:
+            return
+
+        event.wait()
+
+        del self.events[fn]
+        self.results.pop(fn, None)
+        self.window.release()
+
+    def stop(self):
+
+        with self.lock:
+            self.quit = True
+
+        for _i in self.threads:
+            self.window.release()
+
+        for t in self.threads:
+            t.join()
+
+
 class Script(object):
     """
     This class represents a Ren'Py script, which is parsed out of a
@@ -123,10 +497,8 @@ class Script(object):
 
         self.record_pycode = True
 
-        # Bytecode caches.
-        self.bytecode_oldcache = { }
-        self.bytecode_newcache = { }
-        self.bytecode_dirty = False
+        # The bytecode cache.
+        self.bytecode_cache = BytecodeCache()
 
         self.translator = renpy.translation.ScriptTranslator()
         self.init_bytecode()
@@ -144,6 +516,34 @@ class Script(object):
 
         self.duplicate_labels = [ ]
 
+        # The RpycPrefetcher used while loading the script, if any.
+        self.rpyc_prefetcher = None
+
+        # A map from the name of each node in a block that hasn't been
+        # loaded yet to the label the block belongs to, and the number of
+        # such blocks.
+        self.lazy_names = { }
+        self.lazy_blocks = 0
+
+        # True once analyze has been called after init, so blocks loaded
+        # later are analyzed right away.
+        self.analyzed = False
+
+        # The time spent in each part of loading .rpyc files. I/O and
+        # decompression times are summed across the threads that do them.
+        self.load_times = { "io" : 0.0, "decompress" : 0.0, "unpickle" : 0.0, "finish_load" : 0.0 }
+        self.load_times_lock = threading.Lock()
+
+    def add_load_time(self, kind, start):
+        """
+        Adds the time since `start` to the load time of `kind`.
+        """
+
+        t = time.time() - start
+
+        with self.load_times_lock:
+            self.load_times[kind] += t
+
     def choose_backupdir(self):
 
         if renpy.mobile:
@@ -270,17 +670,51 @@ class Script(object):
 
         initcode = [ ]
 
-        for fn, dir in script_files: # @ReservedAssignment
-            # Mitigate "busy script" warning from the browser
-            if renpy.emscripten:
-                import emscripten
-                emscripten.sleep(0)
+        start = time.time()
 
-            # Pump the presplash window to prevent marking
-            # our process as unresponsive by OS
-            renpy.display.presplash.pump_window()
+        if not renpy.emscripten:
+            self.rpyc_prefetcher = RpycPrefetcher(self, self.prefetch_filenames(script_files, ".rpyc", ".rpy"))
 
-            self.load_appropriate_file(".rpyc", ".rpy", dir, fn, initcode)
+        try:
+
+            for fn, dir in script_files: # @ReservedAssignment
+                # Mitigate "busy script" warning from the browser
+                if renpy.emscripten:
+                    import emscripten
+                    emscripten.sleep(0)
+
+                # Pump the presplash window to prevent marking
+                # our process as unresponsive by OS
+                renpy.display.presplash.pump_window()
+
+                self.load_appropriate_file(".rpyc", ".rpy", dir, fn, initcode)
+
+                if self.rpyc_prefetcher is not None:
+                    self.rpyc_prefetcher.done(fn + ".rpyc")
+
+        finally:
+
+            if self.rpyc_prefetcher is not None:
+                self.rpyc_prefetcher.stop()
+                self.rpyc_prefetcher = None
+
+        renpy.display.log.write(
+            "Loaded %d script files in %.2fs: I/O %.2fs, decompress %.2fs, unpickle %.2fs, finish_load %.2fs.",
+            len(script_files),
+            time.time() - start,
+            self.load_times["io"],
+            self.load_times["decompress"],
+            self.load_times["unpickle"],
+            self.load_times["finish_load"],
+            )
+
+        if self.lazy_blocks:
+            renpy.display.log.write(
+                "Loaded %d nodes, and deferred %d nodes in %d label blocks.",
+                len(self.namemap),
+                len(self.lazy_names),
+                self.lazy_blocks,
+                )
 
         # Make the sort stable.
         initcode = [ (prio, index, code) for index, (prio, code) in
@@ -498,19 +932,23 @@ class Script(object):
 
         f.write(RPYC2_HEADER)
 
-        for _i in range(3):
+        for _i in range(5):
             f.write(struct.pack("III", 0, 0, 0))
 
-    def write_rpyc_data(self, f, slot, data):
+    def write_rpyc_data(self, f, slot, data, compress=True):
         """
         Writes data into `slot` of a .rpyc file. The data should be a binary
-        string, and is compressed before being written.
+        string, and is compressed before being written, unless `compress`
+        is false.
         """
 
         f.seek(0, 2)
 
         start = f.tell()
-        data = zlib.compress(data, 3)
+
+        if compress:
+            data = zlib.compress(data, 3)
+
         f.write(data)
 
         f.seek(len(RPYC2_HEADER) + 12 * (slot - 1), 0)
@@ -526,12 +964,58 @@ class Script(object):
         f.seek(0, 2)
         f.write(digest)
 
+    def prefetch_filenames(self, files, compiled, source):
+        """
+        Returns a list of (filename, slots) tuples, giving the compiled
+        files in `files` that load_appropriate_file is likely to load, and
+        the slots load_file will try to read from them.
+        """
+
+        rv = [ ]
+
+        force_compile = renpy.game.args.compile # @UndefinedVariable
+
+        for fn, dir in files: # @ReservedAssignment
+
+            if dir is not None:
+
+                if not os.path.exists(dir + "/" + fn + compiled):
+                    continue
+
+                if force_compile and os.path.exists(dir + "/" + fn + source):
+                    continue
+
+            rv.append((fn + compiled, self.rpyc_slots(self.can_load_lazily(dir, fn, source))))
+
+        return rv
+
+    def prefetch_rpyc(self, fn, slots):
+        """
+        Reads and decompresses the data in the .rpyc file `fn`, from the
+        first of `slots` that exists. This is called on the prefetch
+        threads. Returns a (slot, data) tuple, or None if none of the slots
+        exist.
+        """
+
+        with renpy.loader.load(fn) as f:
+            for slot in slots:
+                bindata = self.read_rpyc_data(f, slot)
+
+                if bindata:
+                    return slot, bindata
+
+                f.seek(0)
+
+        return None
+
     def read_rpyc_data(self, f, slot):
         """
         Reads the binary data from `slot` in a .rpyc (v1 or v2) file. Returns
         the data if the slot exists, or None if the slot does not exist.
         """
 
+        io_start = time.time()
+
         # f.seek(0)
         header_data = f.read(1024)
 
@@ -545,7 +1029,25 @@ class Script(object):
             f.seek(0)
             data = f.read()
 
-            return zlib.decompress(data)
+        else:
+            data = self.read_rpyc_slot(f, header_data, slot)
+
+            if data is None:
+                return None
+
+        self.add_load_time("io", io_start)
+
+        decompress_start = time.time()
+        rv = zlib.decompress(data)
+        self.add_load_time("decompress", decompress_start)
+
+        return rv
+
+    def find_rpyc_slot(self, header_data, slot):
+        """
+        Given `header_data`, the start of a version 2 .rpyc file, returns
+        the (start, length) of `slot`, or None if the slot doesn't exist.
+        """
 
         # RPYC2 path.
         pos = len(RPYC2_HEADER)
@@ -554,17 +1056,226 @@ class Script(object):
             header_slot, start, length = struct.unpack("III", header_data[pos:pos + 12])
 
             if slot == header_slot:
-                break
+                return start, length
 
             if header_slot == 0:
                 return None
 
             pos += 12
 
+    def read_rpyc_slot(self, f, header_data, slot):
+        """
+        Reads the compressed data in `slot` of a version 2 .rpyc file,
+        given the start of the file in `header_data`. Returns None if the
+        slot doesn't exist.
+        """
+
+        location = self.find_rpyc_slot(header_data, slot)
+
+        if location is None:
+            return None
+
+        start, length = location
+
         f.seek(start)
-        data = f.read(length)
+        return f.read(length)
+
+    def rpyc_slots(self, lazy):
+        """
+        Returns the slots load_file tries to load a .rpyc file from, in
+        order. If `lazy` is true, slot 3, which stores the blocks of labels
+        separately, is tried first.
+        """
+
+        if lazy:
+            return [ 3, 2, 1 ]
+        else:
+            return [ 2, 1 ]
+
+    def can_load_lazily(self, dir, fn, source): # @ReservedAssignment
+        """
+        Returns true if the blocks of labels in the compiled version of `fn`
+        can be loaded when they're first used. This is only done when
+        running a game from .rpyc files without their source, since lint,
+        the translation tools, and developer mode need the whole script.
+        """
+
+        if renpy.game.args.command != "run": # @UndefinedVariable
+            return False
+
+        if "RENPY_EAGER_LABELS" in os.environ:
+            return False
+
+        if dir is None:
+            return True
+
+        return not os.path.exists(dir + "/" + fn + source)
+
+    def can_defer_node(self, node):
+        """
+        Returns true if `node` can be part of a block that's loaded when its
+        label is first used. Nodes that have to be seen when the script is
+        loaded can't be.
+        """
+
+        if node.get_init or node.early_execute:
+            return False
+
+        if isinstance(node, (renpy.ast.RPY, renpy.ast.TranslateBlock, renpy.ast.TranslateEarlyBlock, renpy.ast.TranslatePython)):
+            return False
+
+        if isinstance(node, renpy.ast.Translate) and (node.language is not None):
+            return False
+
+        return True
+
+    def lazy_rpyc_data(self, data, stmts):
+        """
+        Returns the data for slots 3 and 4 of a .rpyc file, or None if no
+        label in `stmts` can be loaded lazily.
+
+        Slot 3 is like slot 2, except that the blocks of top-level labels
+        are replaced by LazyBlocks. Slot 4 holds those blocks, each pickled
+        and compressed on its own, at the offsets given by their LazyBlocks.
+        """
+
+        lazy = [ ]
+        blocks = [ ]
+
+        offset = 0
+
+        for i in stmts:
+
+            if not isinstance(i, renpy.ast.Label) or not i.block:
+                continue
+
+            children = [ ]
+
+            for j in i.block:
+                j.get_children(children.append)
+
+            if not all(self.can_defer_node(j) for j in children):
+                continue
+
+            block = zlib.compress(dumps(i.block, 2), 3)
 
-        return zlib.decompress(data)
+            names = [ j.name for j in children ]
+            translates = [ j.identifier for j in children if isinstance(j, renpy.ast.Translate) ]
+
+            lazy.append((i, i.block, renpy.ast.LazyBlock(offset, len(block), names, translates)))
+            blocks.append(block)
+
+            offset += len(block)
+
+        if not lazy:
+            return None
+
+        try:
+            for label, _block, lazy_block in lazy:
+                label.block = lazy_block
+
+            rv = dumps((data, stmts), 2)
+
+        finally:
+            for label, block, _lazy_block in lazy:
+                label.block = block
+
+        return rv, b"".join(blocks)
+
+    def register_lazy_blocks(self, fn, stmts):
+        """
+        Records the LazyBlocks of the labels in `stmts`, which were loaded
+        from the .rpyc file `fn`, so the names and translations in them can
+        be found.
+        """
+
+        for i in stmts:
+
+            if not isinstance(i, renpy.ast.Label):
+                continue
+
+            lazy = i.block
+
+            if lazy.__class__ is not renpy.ast.LazyBlock:
+                continue
+
+            lazy.filename = fn
+
+            for name in lazy.names:
+                self.lazy_names[name] = i
+
+            for identifier in lazy.translates:
+                self.translator.lazy_translates[identifier] = i
+
+            self.lazy_blocks += 1
+
+        # Keep the bytecode of the blocks that haven't been loaded yet.
+        if self.lazy_names:
+            self.bytecode_cache.keep_unused = True
+
+    def materialize(self, label):
+        """
+        Loads the block of `label`, a label whose block is a LazyBlock, and
+        adds the nodes in it to the script.
+        """
+
+        lazy = label.block
+
+        if lazy.__class__ is not renpy.ast.LazyBlock:
+            return
+
+        with renpy.loader.load(lazy.filename) as f:
+            start, _length = self.find_rpyc_slot(f.read(1024), 4)
+            f.seek(start + lazy.offset)
+            block = loads(zlib.decompress(f.read(lazy.length)))
+
+        for name in lazy.names:
+            self.lazy_names.pop(name, None)
+
+        for identifier in lazy.translates:
+            self.translator.lazy_translates.pop(identifier, None)
+
+        self.lazy_blocks -= 1
+
+        next_node = label.next
+
+        label.block = block
+        label.chain(next_node)
+
+        all_stmts = [ ]
+
+        for i in block:
+            i.get_children(all_stmts.append)
+
+        # Fix the filename for a renamed .rpyc file.
+        if all_stmts[0].filename != label.filename:
+            for i in all_stmts:
+                i.filename = label.filename
+
+        self.translator.take_translates([ label ] + all_stmts)
+        self.translator.chain_translates()
+
+        self.update_bytecode()
+
+        for node in all_stmts:
+            self.namemap[node.name] = node
+
+        if self.all_stmts is not None:
+            self.all_stmts.extend(all_stmts)
+
+        self.need_analysis.extend(all_stmts)
+
+        if self.analyzed:
+            self.analyze()
+
+    def materialize_all(self):
+        """
+        Loads every block that hasn't been loaded yet, for code that needs
+        to see the whole script.
+        """
+
+        for label in set(self.lazy_names.values()):
+            self.materialize(label)
 
     def static_transforms(self, stmts):
         """
@@ -576,7 +1287,7 @@ class Script(object):
         # Generate translate nodes.
         renpy.translation.restructure(stmts)
 
-    def load_file(self, dir, fn): # @ReservedAssignment
+    def load_file(self, dir, fn, lazy=False): # @ReservedAssignment
 
         if fn.endswith(".rpy") or fn.endswith(".rpym"):
 
@@ -631,6 +1342,8 @@ class Script(object):
 
             pickle_data_after_static_transforms = dumps((data, stmts), 2)
 
+            lazy_data = self.lazy_rpyc_data(data, stmts)
+
             if not renpy.macapp:
                 try:
                     with open(rpycfn, "wb") as f:
@@ -638,6 +1351,10 @@ class Script(object):
                         self.write_rpyc_data(f, 1, pickle_data_before_static_transforms)
                         self.write_rpyc_data(f, 2, pickle_data_after_static_transforms)
 
+                        if lazy_data is not None:
+                            self.write_rpyc_data(f, 3, lazy_data[0])
+                            self.write_rpyc_data(f, 4, lazy_data[1], compress=False)
+
                         with open(fullfn, "rU") as fullf:
                             rpydigest = hashlib.md5(fullf.read()).digest()
 
@@ -653,13 +1370,23 @@ class Script(object):
             data = None
             stmts = None
 
+            if self.rpyc_prefetcher is not None:
+                prefetched = self.rpyc_prefetcher.get(fn)
+            else:
+                prefetched = None
+
             with renpy.loader.load(fn) as f:
-                for slot in [ 2, 1 ]:
+                for slot in self.rpyc_slots(lazy):
                     try:
-                        bindata = self.read_rpyc_data(f, slot)
+                        if (prefetched is not None) and (prefetched[0] == slot):
+                            bindata = prefetched[1]
+                        else:
+                            bindata = self.read_rpyc_data(f, slot)
 
                         if bindata:
+                            unpickle_start = time.time()
                             data, stmts = loads(bindata)
+                            self.add_load_time("unpickle", unpickle_start)
                             break
 
                     except:
@@ -686,6 +1413,9 @@ class Script(object):
                 if slot < 2:
                     self.static_transforms(stmts)
 
+                if slot == 3:
+                    self.register_lazy_blocks(fn, stmts)
+
         else:
             return None, None
 
@@ -700,7 +1430,7 @@ class Script(object):
 
             rpyfn = fn + source
             lastfn = fn + compiled
-            data, stmts = self.load_file(dir, fn + compiled)
+            data, stmts = self.load_file(dir, fn + compiled, self.can_load_lazily(dir, fn, source))
 
             if data is None:
                 raise Exception("Could not load from archive %s." % (lastfn,))
@@ -772,7 +1502,7 @@ class Script(object):
 
             elif os.path.exists(rpycfn):
                 lastfn = rpycfn
-                data, stmts = self.load_file(dir, fn + compiled)
+                data, stmts = self.load_file(dir, fn + compiled, self.can_load_lazily(dir, fn, source))
 
                 digest = rpycdigest
 
@@ -794,7 +1524,9 @@ class Script(object):
         elif self.key != data['key']:
             raise Exception(fn + " does not share a key with at least one .rpyc file. To fix, delete all .rpyc files, or rerun Ren'Py with the --lock option.")
 
+        finish_load_start = time.time()
         self.finish_load(stmts, initcode, filename=lastfn)
+        self.add_load_time("finish_load", finish_load_start)
 
         self.digest.update(digest)
 
@@ -803,15 +1535,7 @@ class Script(object):
         Init/Loads the bytecode cache.
         """
 
-        # Load the oldcache.
-        try:
-            with renpy.loader.load(BYTECODE_FILE) as f:
-                version, cache = loads(zlib.decompress(f.read()))
-                if version == BYTECODE_VERSION:
-                    self.bytecode_oldcache = cache
-
-        except:
-            pass
+        self.bytecode_cache.load()
 
     def update_bytecode(self):
         """
@@ -836,12 +1560,10 @@ class Script(object):
             if i.location[0] in renpy.python.py3_files:
                 key += b"_py3"
 
-            code = self.bytecode_oldcache.get(key, None)
+            code = self.bytecode_cache.get(key, None)
 
             if code is None:
 
-                self.bytecode_dirty = True
-
                 old_ei = renpy.game.exception_info
                 renpy.game.exception_info = "While compiling python block starting at line %d of %s." % (i.location[1], i.location[0])
 
@@ -877,8 +1599,10 @@ class Script(object):
 
                 renpy.game.exception_info = old_ei
 
-            self.bytecode_newcache[key] = code
+                self.bytecode_cache.add(key, code)
+
             i.bytecode = marshal.loads(code)
+            renpy.python.note_global_names(i.bytecode)
 
         self.all_pycode = [ ]
 
@@ -886,15 +1610,10 @@ class Script(object):
         if renpy.macapp:
             return
 
-        if self.bytecode_dirty:
-            try:
-                fn = renpy.loader.get_path(BYTECODE_FILE)
-
-                with open(fn, "wb") as f:
-                    data = (BYTECODE_VERSION, self.bytecode_newcache)
-                    f.write(zlib.compress(dumps(data, 2), 3))
-            except:
-                pass
+        try:
+            self.bytecode_cache.save()
+        except:
+            pass
 
     def lookup(self, label):
         """
@@ -910,6 +1629,10 @@ class Script(object):
 
         rv = self.namemap.get(label, None)
 
+        if (rv is None) and (label in self.lazy_names):
+            self.materialize(self.lazy_names[label])
+            rv = self.namemap.get(label, None)
+
         if (rv is None) and (renpy.config.missing_label_callback is not None):
             label = renpy.config.missing_label_callback(label)
             rv = self.namemap.get(label, None)
@@ -933,7 +1656,7 @@ class Script(object):
 
         label = renpy.config.label_overrides.get(label, label)
 
-        return label in self.namemap
+        return (label in self.namemap) or (label in self.lazy_names)
 
     def lookup_or_none(self, label):
         """
@@ -957,6 +1680,7 @@ class Script(object):
             i.analyze()
 
         self.need_analysis = [ ]
+        self.analyzed = True
 
     def report_duplicate_labels(self):
         if not renpy.config.developer:
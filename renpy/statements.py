@@ -251,6 +251,10 @@ def parse(node, line, subblock):
     This is used for runtime parsing of CDSes that were created before 7.3.
     """
 
+    # The lexer works on unicode, while a line from an old save may be bytes.
+    if isinstance(line, bytes):
+        line = line.decode("utf-8")
+
     block = [ (node.filename, node.linenumber, line, subblock) ]
     l = renpy.parser.Lexer(block)
     l.advance()
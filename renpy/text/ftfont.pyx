@@ -56,6 +56,15 @@ cdef struct glyph_cache:
     int bitmap_left
     int bitmap_top
 
+# The glyph cache is set-associative, with CACHE_WAYS entries in each of
+# CACHE_SETS sets. A glyph can only be stored in the set given by the low
+# bits of its index. A layout looks up each glyph once per pass (sizing,
+# bounds, and once per outline), so the cache needs to hold a full page of
+# glyphs - including CJK text - to avoid rasterizing glyphs multiple times.
+DEF CACHE_SETS = 256
+DEF CACHE_WAYS = 4
+DEF CACHE_SIZE = CACHE_SETS * CACHE_WAYS
+
 
 class FreetypeError(Exception):
     def __init__(self, code):
@@ -259,7 +268,10 @@ cdef class FTFont:
         public int height
         public int lineskip
 
-        glyph_cache cache[256]
+        glyph_cache cache[CACHE_SIZE]
+
+        # The way in each set that will be replaced next.
+        unsigned char cache_victim[CACHE_SETS]
 
         # Have we been setup at least once?
         bint has_setup
@@ -268,14 +280,17 @@ cdef class FTFont:
         int hinting
 
     def __cinit__(self):
-        for i from 0 <= i < 256:
+        for i from 0 <= i < CACHE_SIZE:
             self.cache[i].index = -1
             FT_Bitmap_New(&(self.cache[i].bitmap))
 
+        for i from 0 <= i < CACHE_SETS:
+            self.cache_victim[i] = 0
+
         init_gsubtable(&self.gsubtable)
 
     def __dealloc__(self):
-        for i from 0 <= i < 256:
+        for i from 0 <= i < CACHE_SIZE:
             FT_Bitmap_Done(library, &(self.cache[i].bitmap))
 
         if self.stroker != NULL:
@@ -395,7 +410,9 @@ cdef class FTFont:
 
         cdef int error
         cdef glyph_cache *rv
+        cdef glyph_cache *ways
         cdef uint32_t vindex
+        cdef int set_index, way
 
         cdef int overhang
         cdef FT_Glyph_Metrics metrics
@@ -415,10 +432,18 @@ cdef class FTFont:
         else:
             glyph_rotate = 0
 
-        rv = &(self.cache[index & 255])
-        if rv.index == index:
-            return rv
+        set_index = index & (CACHE_SETS - 1)
+        ways = &(self.cache[set_index * CACHE_WAYS])
+
+        for way from 0 <= way < CACHE_WAYS:
+            if ways[way].index == index:
+                return &(ways[way])
+
+        # Not found, so replace the ways of the set in rotation.
+        way = self.cache_victim[set_index]
+        self.cache_victim[set_index] = (way + 1) % CACHE_WAYS
 
+        rv = &(ways[way])
         rv.index = index
 
         error = FT_Load_Glyph(face, index, self.hinting)
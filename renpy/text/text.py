@@ -870,6 +870,7 @@ class Layout(object):
 
         # Store the lines, so we have them for typeout.
         self.lines = lines
+        self.reset_typewriter()
 
         # Store the hyperlinks, if any.
         if self.has_hyperlinks:
@@ -1348,6 +1349,110 @@ class Layout(object):
 
         return outlines, right - left, bottom - top, -left, -top
 
+    def reset_typewriter(self):
+        """
+        Resets the typewriter state, so that the next call to
+        blits_typewriter starts from the first line.
+        """
+
+        # The st the typewriter state was last advanced to.
+        self.typewriter_st = -1
+
+        # The index of the first line that isn't completely shown.
+        self.typewriter_line = 0
+
+        # The bottom of the last completely shown line.
+        self.typewriter_max_y = 0
+
+        # The glyphs in the partially-shown line, sorted by time, and the
+        # index of the first of those glyphs that isn't shown yet.
+        self.typewriter_glyphs = None
+        self.typewriter_cursor = 0
+
+        # The extent of the shown part of the partially-shown line.
+        self.typewriter_min_x = self.size[0]
+        self.typewriter_max_x = 0
+        self.typewriter_left = False
+        self.typewriter_right = False
+
+        # The blits returned by the last call to blits_typewriter, or None
+        # if they need to be recomputed.
+        self.typewriter_blits = None
+
+    def advance_typewriter(self, st):
+        """
+        Advances the typewriter state to `st`. This only looks at the lines
+        and glyphs that have been revealed since the last call, unless time
+        has gone backwards.
+        """
+
+        if st < self.typewriter_st:
+            self.reset_typewriter()
+
+        self.typewriter_st = st
+
+        lines = self.lines
+        len_lines = len(lines)
+
+        max_height = self.size[1]
+
+        i = self.typewriter_line
+
+        while i < len_lines and lines[i].max_time <= st:
+            l = lines[i]
+            self.typewriter_max_y = min(l.y + l.height + self.line_overlap_split, max_height)
+            i += 1
+
+        if i != self.typewriter_line:
+            self.typewriter_line = i
+            self.typewriter_glyphs = None
+            self.typewriter_blits = None
+
+        if i == len_lines:
+            return
+
+        l = lines[i]
+
+        if self.typewriter_glyphs is None:
+            self.typewriter_glyphs = sorted((g for g in l.glyphs if g.time != -1), key=lambda g : g.time)
+            self.typewriter_cursor = 0
+            self.typewriter_min_x = self.size[0]
+            self.typewriter_max_x = 0
+            self.typewriter_left = False
+            self.typewriter_right = False
+
+        glyphs = self.typewriter_glyphs
+        len_glyphs = len(glyphs)
+        cursor = self.typewriter_cursor
+
+        if cursor == len_glyphs or glyphs[cursor].time > st:
+            return
+
+        first = l.glyphs[0]
+        last = l.glyphs[-1]
+
+        while cursor < len_glyphs:
+            g = glyphs[cursor]
+
+            if g.time > st:
+                break
+
+            if g is first:
+                self.typewriter_left = True
+            if g is last:
+                self.typewriter_right = True
+
+            if g.x + g.advance > self.typewriter_max_x:
+                self.typewriter_max_x = g.x + g.advance
+
+            if g.x < self.typewriter_min_x:
+                self.typewriter_min_x = g.x
+
+            cursor += 1
+
+        self.typewriter_cursor = cursor
+        self.typewriter_blits = None
+
     def blits_typewriter(self, st):
         """
         Given a st and an outline, returns a list of blit objects that
@@ -1355,25 +1460,27 @@ class Layout(object):
 
         This also sets the extreme points when creating a Blit.
 
+        The list is reused between calls until more text is revealed, so
+        it should not be modified.
         """
 
-        width, max_height = self.size
-
-        rv = [ ]
-
         if not self.lines:
-            return rv
+            return [ ]
 
-        max_y = 0
-        top = True
+        self.advance_typewriter(st)
 
-        for l in self.lines:
+        if self.typewriter_blits is not None:
+            return self.typewriter_blits
 
-            if l.max_time > st:
-                break
+        width, max_height = self.size
 
-            max_y = min(l.y + l.height + self.line_overlap_split, max_height)
+        rv = [ ]
 
+        max_y = self.typewriter_max_y
+        top = True
+
+        if self.typewriter_line < len(self.lines):
+            l = self.lines[self.typewriter_line]
         else:
             l = None
 
@@ -1381,59 +1488,41 @@ class Layout(object):
             rv.append(Blit(0, 0, width, max_y, top=top, left=True, right=True, bottom=(l is None)))
             top = False
 
-        if l is None:
-            return rv
-
         # If l is not none, then we have a line for which max_time has not
         # yet been reached. Blit it.
+        if l is not None:
 
-        min_x = width
-        max_x = 0
-
-        left = False
-        right = False
-
-        for g in l.glyphs:
+            min_x = self.typewriter_min_x
+            max_x = self.typewriter_max_x
 
-            if g.time == -1:
-                continue
-
-            if g.time > st:
-                continue
+            ly = min(l.y + l.height + self.line_overlap_split, max_height)
 
-            if g is l.glyphs[0]:
-                left = True
-            if g is l.glyphs[-1]:
-                right = True
+            if min_x < max_x:
+                rv.append(Blit(min_x, max_y, max_x - min_x, ly - max_y, left=self.typewriter_left, right=self.typewriter_right, top=top, bottom=(l is self.lines[-1])))
 
-            if g.x + g.advance > max_x:
-                max_x = g.x + g.advance
-
-            if g.x < min_x:
-                min_x = g.x
-
-        ly = min(l.y + l.height + self.line_overlap_split, max_height)
-
-        if min_x < max_x:
-            rv.append(Blit(min_x, max_y, max_x - min_x, ly - max_y, left=left, right=right, top=top, bottom=(l is self.lines[-1])))
+        self.typewriter_blits = rv
 
         return rv
 
     def redraw_typewriter(self, st):
         """
-        Return the time of the first glyph that should be shown after st.
+        Return the amount of time until the next glyph should be shown
+        after st, or None if all glyphs have been shown.
         """
 
-        for l in self.lines:
-            if not l.glyphs:
-                continue
+        if not self.lines:
+            return None
 
-            if l.max_time > st:
-                break
+        self.advance_typewriter(st)
 
-        else:
+        if self.typewriter_line == len(self.lines):
             return None
 
+        glyphs = self.typewriter_glyphs
+
+        if self.typewriter_cursor < len(glyphs):
+            return max(glyphs[self.typewriter_cursor].time - st, 0)
+
         return 0
 
 
@@ -1466,6 +1555,14 @@ def layout_cache_clear():
 # A list of slow text that's being displayed right now.
 slow_text = [ ]
 
+# The maximum number of entries in the tokenize cache.
+TOKENIZE_CACHE_SIZE = 250
+
+# Maps from a string to the list of tokens it contains. Lines like choices,
+# names and UI labels are shown again and again, so this lets them skip
+# tokenization.
+tokenize_cache = { }
+
 
 def text_tick():
     """
@@ -2249,11 +2346,24 @@ class Text(renpy.display.core.Displayable):
 
         for i in text:
 
-            if isinstance(i, str):
-                tokens.extend(textsupport.tokenize(i))
+            if isinstance(i, basestring):
+
+                if not isinstance(i, str):
+                    i = str(i)
+
+                # The cached list is never modified, as it's only used to
+                # extend the list of tokens.
+                t = tokenize_cache.get(i, None)
+
+                if t is None:
+                    t = textsupport.tokenize(i)
+
+                    if len(tokenize_cache) > TOKENIZE_CACHE_SIZE:
+                        tokenize_cache.clear()
+
+                    tokenize_cache[i] = t
 
-            elif isinstance(i, basestring):
-                tokens.extend(textsupport.tokenize(str(i)))
+                tokens.extend(t)
 
             elif isinstance(i, renpy.display.core.Displayable):
                 tokens.append((DISPLAYABLE, i))
@@ -62,69 +62,88 @@ def tokenize(unicode s):
     This tokenizes a unicode string into text tags and tokens. It returns a list
     of pairs, where each pair begins with TEXT, TAG or PARAGRAPH, and then has
     the contents of the text run or tag.
+
+    Text runs and tags are sliced out of `s` whole, rather than being built
+    up a character at a time.
     """
 
-    cdef int TEXT_STATE = 1
-    cdef int LEFT_BRACE_STATE = 2
-    cdef int TAG_STATE = 3
-    cdef int state = TEXT_STATE
+    cdef Py_ssize_t len_s = len(s)
+    cdef Py_ssize_t i = 0
+    cdef Py_ssize_t end
 
-    cdef Py_UNICODE c
-    cdef unicode buf = u''
+    # The start of the text run we're in.
+    cdef Py_ssize_t start = 0
 
-    cdef list rv = [ ]
+    cdef Py_UCS4 c
 
-    for c in s:
+    # Pieces of the current text run that precede an escaped brace. This is
+    # only used when the run contains {{.
+    cdef list parts = [ ]
 
-        if state == TEXT_STATE:
+    cdef unicode buf
 
-            if c == u'\n':
-                if buf:
-                    rv.append((TEXT, buf))
+    cdef list rv = [ ]
 
-                rv.append((PARAGRAPH, u''))
-                buf = u''
+    while i < len_s:
 
-                continue
+        c = s[i]
 
-            elif c == u'{':
-                state = LEFT_BRACE_STATE
-                continue
+        if c == u'\n':
 
+            if parts:
+                parts.append(s[start:i])
+                buf = u''.join(parts)
+                parts = [ ]
             else:
-                buf += c
-                continue
+                buf = s[start:i]
+
+            if buf:
+                rv.append((TEXT, buf))
+
+            rv.append((PARAGRAPH, u''))
+
+            i += 1
+            start = i
 
-        elif state == LEFT_BRACE_STATE:
-            if c == u'{':
-                buf += c
-                state = TEXT_STATE
+        elif c == u'{':
+
+            if i + 1 < len_s and s[i + 1] == u'{':
+                parts.append(s[start:i + 1])
+                i += 2
+                start = i
                 continue
 
-            elif c == u'}':
+            if i + 1 < len_s and s[i + 1] == u'}':
                 raise Exception("Empty text tag in {0!r}.".format(s))
 
+            end = s.find(u'}', i + 1)
+
+            if end == -1:
+                raise Exception("Open text tag at end of string {0!r}.".format(s))
+
+            if parts:
+                parts.append(s[start:i])
+                buf = u''.join(parts)
+                parts = [ ]
             else:
-                if buf:
-                    rv.append((TEXT, buf))
+                buf = s[start:i]
 
-                buf = c
-                state = TAG_STATE
-                continue
+            if buf:
+                rv.append((TEXT, buf))
 
-        elif state == TAG_STATE:
+            rv.append((TAG, s[i + 1:end]))
 
-            if c == u'}':
-                rv.append((TAG, buf))
-                buf = u''
-                state = TEXT_STATE
-                continue
+            i = end + 1
+            start = i
 
-            else:
-                buf += c
+        else:
+            i += 1
 
-    if state != TEXT_STATE:
-        raise Exception("Open text tag at end of string {0!r}.".format(s))
+    if parts:
+        parts.append(s[start:len_s])
+        buf = u''.join(parts)
+    else:
+        buf = s[start:len_s]
 
     if buf:
         rv.append((TEXT, buf))
@@ -25,7 +25,7 @@ from __future__ import print_function
 
 import time
 from textsupport cimport Glyph, SPLIT_INSTEAD, SPLIT_BEFORE, SPLIT_NONE, RUBY_TOP, RUBY_ALT
-from libc.stdlib cimport calloc, malloc, free
+from libc.stdlib cimport realloc
 
 import collections
 times = collections.defaultdict(float)
@@ -47,34 +47,85 @@ cdef struct Word:
     double end_x
 
 
+# Buffers that are shared between calls to the word wrapper, and are grown
+# as needed. Line breaking always takes place with the GIL held, so there's
+# no need for these to be per-wrapper.
+cdef Word *words_buffer = NULL
+cdef double *scores_buffer = NULL
+cdef int *splits_buffer = NULL
+
+# The candidate queue used by knuth_plass. queue_index is the index of the
+# word a candidate line starts at, and queue_start is the first line end
+# (in words) that candidate is the best start for.
+cdef int *queue_index_buffer = NULL
+cdef int *queue_start_buffer = NULL
+
+cdef int buffer_size = 0
+
+cdef void ensure_buffers(int size):
+    """
+    Makes sure the shared buffers can hold at least `size` entries.
+    """
+
+    global words_buffer, scores_buffer, splits_buffer
+    global queue_index_buffer, queue_start_buffer, buffer_size
+
+    if size <= buffer_size:
+        return
+
+    if size < buffer_size * 2:
+        size = buffer_size * 2
+
+    if size < 256:
+        size = 256
+
+    words_buffer = <Word *> realloc(words_buffer, size * sizeof(Word))
+    scores_buffer = <double *> realloc(scores_buffer, size * sizeof(double))
+    splits_buffer = <int *> realloc(splits_buffer, size * sizeof(int))
+    queue_index_buffer = <int *> realloc(queue_index_buffer, size * sizeof(int))
+    queue_start_buffer = <int *> realloc(queue_start_buffer, size * sizeof(int))
+
+    buffer_size = size
+
+
 cdef class WordWrapper(object):
 
-    # The list of words created.
+    # The list of words created. These point into the shared buffers, and
+    # are only valid until the next WordWrapper is created.
     cdef Word *words
     cdef int len_words
     cdef list glyphs
     cdef double *scores
     cdef int *splits
 
+    # The width of every line but the first.
+    cdef double rest_width
+
+    # The candidate queue, and the range [queue_head, queue_tail) that's
+    # in use.
+    cdef int *queue_index
+    cdef int *queue_start
+    cdef int queue_head
+    cdef int queue_tail
+
     def __init__(self, list glyphs, first_width, rest_width, subtitle):
 
         if not glyphs:
             return
 
+        ensure_buffers(len(glyphs) + 1)
+
+        self.words = words_buffer
+        self.scores = scores_buffer
+        self.splits = splits_buffer
+        self.queue_index = queue_index_buffer
+        self.queue_start = queue_start_buffer
+
         self.glyphs = glyphs
         self.make_word_list(glyphs)
         self.knuth_plass(first_width, rest_width, subtitle)
         self.unmark_splits()
 
-    def __dealloc__(self):
-        if self.words:
-            free(self.words)
-        if self.scores:
-            free(self.scores)
-        if self.splits:
-            free(self.splits)
-
-
     cdef void unmark_splits(self):
 
         cdef list glyphs = self.glyphs
@@ -96,66 +147,184 @@ cdef class WordWrapper(object):
 
             end = start
 
+    cdef inline double line_score(self, int i, int j):
+        """
+        Returns the score of breaking the text into lines such that there
+        is a line containing words i through j-1, where i is not the first
+        word. This is INFINITY if the line doesn't fit in rest_width.
+        """
+
+        cdef double width = self.words[j-1].end_x - self.words[i].start_x
+
+        if width > self.rest_width:
+            return INFINITY
+
+        return self.scores[i] + 100000 + (self.rest_width - width) * (self.rest_width - width)
+
+    cdef void push_candidate(self, int c, int j, int last):
+        """
+        Adds word `c` to the candidate queue as a possible start of a line,
+        where `j` is the first line end it's eligible for, and `last` is the
+        last line end the queue is used for.
+
+        Since the squared-slack score satisfies the quadrangle inequality,
+        once a later candidate is at least as good as an earlier one, it
+        stays that way for every later line end. So the queue is ordered,
+        and each candidate is the best for a contiguous range of line ends.
+        """
+
+        cdef int *queue_index = self.queue_index
+        cdef int *queue_start = self.queue_start
+        cdef int b, start
+        cdef int lo, hi, mid
+
+        # Discard candidates that c is at least as good as over their whole
+        # range.
+        while self.queue_tail > self.queue_head:
+            b = queue_index[self.queue_tail - 1]
+            start = queue_start[self.queue_tail - 1]
+
+            if start < j:
+                start = j
+
+            if self.line_score(c, start) <= self.line_score(b, start):
+                self.queue_tail -= 1
+            else:
+                break
+
+        if self.queue_tail == self.queue_head:
+            queue_index[self.queue_tail] = c
+            queue_start[self.queue_tail] = j
+            self.queue_tail += 1
+            return
+
+        # Binary search for the first line end where c beats the last
+        # candidate.
+        b = queue_index[self.queue_tail - 1]
+
+        lo = queue_start[self.queue_tail - 1]
+        if lo < j:
+            lo = j
+
+        lo += 1
+        hi = last + 1
+
+        while lo < hi:
+            mid = (lo + hi) // 2
+
+            if self.line_score(c, mid) <= self.line_score(b, mid):
+                hi = mid
+            else:
+                lo = mid + 1
+
+        if lo <= last:
+            queue_index[self.queue_tail] = c
+            queue_start[self.queue_tail] = lo
+            self.queue_tail += 1
 
     cdef void knuth_plass(self, int first_width, int rest_width, bint subtitle):
+        """
+        Finds the total-fit set of line breaks, in O(n log n) time in the
+        number of words.
+
+        Lines that start at the first word (which use first_width), a single
+        word that overflows its line, and the unpenalized last line don't
+        fit the ordering used by the candidate queue, so those are scored
+        directly.
+        """
 
-        cdef double *scores
-        cdef int *splits
+        cdef double *scores = self.scores
+        cdef int *splits = self.splits
         cdef Word *words = self.words
         cdef int len_words = self.len_words
-        cdef double line_width
 
-        cdef int i, j
+        cdef int i, j, last
         cdef double score, min_score
         cdef int split
-        cdef double j_x, width
+        cdef double j_x, width, line_width
+
+        self.rest_width = rest_width
+        self.queue_head = 0
+        self.queue_tail = 0
 
-        scores = <double *> calloc(self.len_words + 1, sizeof(double))
-        self.scores = scores
-        splits = <int *> calloc(self.len_words + 1, sizeof(int))
-        self.splits = splits
+        # The last line end the candidate queue is used for. Unless this is
+        # a subtitle, the final line isn't penalized for the space left on it.
+        if subtitle:
+            last = len_words
+        else:
+            last = len_words - 1
 
         # Base case, for a list of 0 length.
         scores[0] = 0.0
         splits[0] = 0
 
-        for 1 <= j <= self.len_words:
+        for 1 <= j <= len_words:
 
             j_x = words[j-1].end_x
 
             min_score = INFINITY
             split = j - 1
-            i = j
 
-            while i > 0:
+            if j <= last:
+
+                if j >= 2:
+                    self.push_candidate(j - 1, j, last)
 
-                i -= 1
+                while (self.queue_tail - self.queue_head > 1) and (self.queue_start[self.queue_head + 1] <= j):
+                    self.queue_head += 1
 
-                # The score taken from the previous line.
-                score = scores[i] + 100000
+                if self.queue_head < self.queue_tail:
+                    i = self.queue_index[self.queue_head]
+                    min_score = self.line_score(i, j)
 
-                # The width of the current line.
-                width = j_x - words[i].start_x
+                    if min_score < INFINITY:
+                        split = i
 
-                if i == 0:
-                    line_width = first_width
-                else:
-                    line_width = rest_width
+            else:
 
-                if width > line_width:
-                    # Only accept single-word long lines. Otherwise, give up and
-                    # stop looping.
-                    if i < j - 1:
+                # The last line, where we only care about the number of lines.
+                i = j
+
+                while i > 1:
+
+                    i -= 1
+
+                    if j_x - words[i].start_x > rest_width:
                         break
-                    else:
-                        score += 100000.0 * (width - line_width)
 
-                elif subtitle or j != len_words:
+                    score = scores[i] + 100000
+
+                    if score < min_score:
+                        min_score = score
+                        split = i
+
+            # A line that starts at the first word. This is only considered
+            # when every line starting at a later word (but the last) fits in
+            # rest_width, which is what the old backwards scan did.
+            width = j_x - words[0].start_x
+
+            if (width <= first_width) and (j <= 2 or j_x - words[1].start_x <= rest_width):
+                score = 100000
+
+                if j <= last:
+                    score += (first_width - width) * (first_width - width)
+
+                if score < min_score:
+                    min_score = score
+                    split = 0
+
+            # A single word that's too long for its line.
+            i = j - 1
+            width = j_x - words[i].start_x
+
+            if i == 0:
+                line_width = first_width
+            else:
+                line_width = rest_width
 
-                    # Add a penalty proportional to the space left on the line.
-                    score += (line_width - width) * (line_width - width)
+            if width > line_width:
+                score = scores[i] + 100000 + 100000.0 * (width - line_width)
 
-                # If we beat the last score, use it.
                 if score < min_score:
                     min_score = score
                     split = i
@@ -181,7 +350,7 @@ cdef class WordWrapper(object):
         cdef int len_words = 0
 
 
-        words = <Word *> calloc(len_glyphs, sizeof(Word))
+        words = self.words
         word = words
 
         start_glyph = glyphs[0]
@@ -225,7 +394,6 @@ cdef class WordWrapper(object):
         len_words += 1
 
         self.len_words = len_words
-        self.words = words
 
 
 
@@ -49,6 +49,10 @@ class ScriptTranslator(object):
         # language is None.
         self.default_translates = { }
 
+        # A map from the identifier of a translate in a block that hasn't been
+        # loaded yet to the label the block belongs to.
+        self.lazy_translates = { }
+
         # A map from (identifier, language) to the translate object used for that
         # language.
         self.language_translates = { }
@@ -84,7 +88,7 @@ class ScriptTranslator(object):
         Return the number of dialogue blocks in the game.
         """
 
-        return len(self.default_translates)
+        return len(self.default_translates) + len(self.lazy_translates)
 
     def take_translates(self, nodes):
         """
@@ -198,6 +202,10 @@ class ScriptTranslator(object):
             tl = None
 
         if tl is None:
+
+            if identifier in self.lazy_translates:
+                renpy.game.script.materialize(self.lazy_translates[identifier])
+
             tl = self.default_translates[identifier]
 
         return tl.block[0]